@@ -0,0 +1,199 @@
+//  AT command engine shared by the Wisol and Akeru drivers.
+#ifdef ARDUINO
+  #if (ARDUINO >= 100)
+    #include <Arduino.h>
+  #else  //  ARDUINO >= 100
+    #include <WProgram.h>
+  #endif  //  ARDUINO  >= 100
+#endif  //  ARDUINO
+
+#include "SIGFOX.h"
+#include "ATEngine.h"
+
+static NullPort nullPort;
+
+//  UART rates tried by detectBitsPerSecond() after the current rate, in hundreds of bps.
+static const uint16_t detectRates[] PROGMEM = { 96, 192, 384, 576, 1152, 48, 24 };
+
+bool atParseString(const ATParser &response, void *result) {
+  *(String *) result = response.getData();
+  return true;
+}
+
+bool atParseInt(const ATParser &response, void *result) {
+  if (response.getDataLength() == 0) return false;
+  *(int *) result = atoi(response.getData());
+  return true;
+}
+
+static void sleep(int milliSeconds) {
+  //  Delay for the number of milliseconds.  Bean+ sleeps to save power.
+#ifdef BEAN_BEAN_BEAN_H
+  Bean.sleep(milliSeconds);
+#else  // BEAN_BEAN_BEAN_H
+  delay(milliSeconds);
+#endif // BEAN_BEAN_BEAN_H
+}
+
+ATEngine::ATEngine(SIGFOX_SERIAL_PORT *port, unsigned long bitsPerSecond0, const char *end0,
+                   uint8_t pacing0, bool skipEcho0) {
+  serialPort = port;
+  bitsPerSecond = bitsPerSecond0;
+  end = end0;
+  pacing = pacing0;
+  skipEcho = skipEcho0;
+  session = false;
+  timing = ATTiming();
+  echoPort = &nullPort;
+  captureHook = 0;
+  captureContext = 0;
+}
+
+bool ATEngine::beginSession() {
+  //  Start the serial interface and wait for the module.  Commands sent before
+  //  endSession() share the session instead of each opening the port again.
+  if (session) return true;
+  if (!serialBegin(serialPort, bitsPerSecond)) {
+    echoPort->print(F(" - ATEngine.beginSession: Error: Port can't open at ")); echoPort->println(bitsPerSecond);
+    return false;
+  }
+  sleep(200);
+  serialListen(serialPort);
+  session = true;
+  return true;
+}
+
+void ATEngine::endSession() {
+  if (!session) return;
+  serialEnd(serialPort);
+  session = false;
+}
+
+void ATEngine::writeByte(uint8_t ch) {
+  //  Write char by char because SoftwareSerial has no FIFO and may overflow.
+  //  The drivers pass SIGFOX_SERIAL_PACING() so a hardware UART isn't paced.
+  serialPort->write(ch);
+  if (captureHook) captureHook(captureContext, true, ch);
+  if (pacing > 0) sleep(pacing);
+#ifdef SIGFOX_SERIAL_QUEUED
+  //  write() only queued the byte.  To drop the echo, wait until the byte and
+  //  the idle time after it have been sent.  Otherwise keep queueing.
+  if (skipEcho) serialPort->waitForTransmit();
+#endif  //  SIGFOX_SERIAL_QUEUED
+  timing.bytesSent++;
+  if (!skipEcho || serialPort->available() <= 0 || serialPort->peek() != ch) return;
+  serialPort->read();  //  Drop the echo.
+  if (captureHook) captureHook(captureContext, false, ch);
+  timing.bytesReceived++;
+}
+
+void ATEngine::writeText(const char *text, bool flash) {
+  //  Write the text from flash or RAM, and log it.
+  if (!text) return;
+  for (;;) {
+    const uint8_t ch = flash ? pgm_read_byte(text) : (uint8_t) *text;
+    if (ch == 0) return;
+    writeByte(ch);
+    if (ch != '\r' && ch != '\n') echoPort->write(ch);
+    text++;
+  }
+}
+
+bool ATEngine::detectBitsPerSecond(const ATCommand *probe) {
+  //  Each rate is tried in its own session, since the port must be opened at that rate.
+  const unsigned long current = bitsPerSecond;
+  for (uint8_t i = 0; i <= sizeof(detectRates) / sizeof(detectRates[0]); i++) {
+    if (i > 0) {
+      const unsigned long rate = 100UL * pgm_read_word(&detectRates[i - 1]);
+      if (rate == current) continue;
+      setBitsPerSecond(rate);
+    }
+    if (run(probe)) {
+      echoPort->print(F(" - ATEngine.detectBitsPerSecond: ")); echoPort->println(bitsPerSecond);
+      return true;
+    }
+  }
+  setBitsPerSecond(current);
+  echoPort->println(F(" - ATEngine.detectBitsPerSecond: Error: No response"));
+  return false;
+}
+
+uint8_t ATEngine::runAll(const ATStep *steps, uint8_t count) {
+  //  Pipeline the commands in one session instead of opening the port and waiting
+  //  for the module to settle before each one.
+  const bool ownSession = !session;
+  if (!beginSession()) return 0;
+  uint8_t done = 0;
+  while (done < count && run(steps[done].command, steps[done].result, steps[done].argument)) done++;
+  if (ownSession) endSession();
+  return done;
+}
+
+bool ATEngine::run(const ATCommand *command, void *result, const char *argument) {
+  //  Send the command and read the response until it is complete or times out.
+  ATCommand cmd;
+  memcpy_P(&cmd, command, sizeof(cmd));
+  timing = ATTiming();
+  parser.reset();
+  //  Start serial interface, unless the command is part of a session.
+  const bool ownSession = !session;
+  if (!beginSession()) {
+    latency.addTimeout(cmd.type);
+    return false;
+  }
+
+  //  Send the command literal, argument, suffix and end.
+  echoPort->print(F(">> "));
+  const unsigned long transmitStart = millis();
+  writeText(cmd.command, true);
+  writeText(argument, false);
+  writeText(cmd.suffix, true);
+  writeText(end, false);
+  echoPort->println();
+  const unsigned long startTime = millis();  //  Start the timer only when all data has been sent.
+  timing.transmit = startTime - transmitStart;
+
+  //  Feed the response to the parser as it arrives.  Loop until timeout or the response is complete.
+  uint8_t lines = 0, line = AT_LINE_NONE; unsigned long lineTime = 0; bool complete = false;
+  echoPort->print(F("<< "));
+  for (;;) {
+    const unsigned long currentTime = millis();
+    if (currentTime - startTime > cmd.timeout) break;
+    //  Wait for the response without spinning if the port supports it.
+    if (!waitForSerial(serialPort, cmd.timeout - (currentTime - startTime))) continue;
+    const int rxChar = serialPort->read();
+    if (rxChar < 0) continue;
+    if (captureHook) captureHook(captureContext, false, (uint8_t) rxChar);
+    timing.bytesReceived++;
+    line = parser.feed((uint8_t) rxChar);
+    if (line == AT_LINE_NONE) {
+      if (rxChar != '\r' && rxChar != '\n') echoPort->write((uint8_t) rxChar);
+      continue;
+    }
+    echoPort->print(' ');
+    //  Time to the first line (e.g. OK) and from there to the second (e.g. downlink).
+    const unsigned long now = millis();
+    if (lines == 0) timing.response = now - startTime;
+    else if (lines == 1) timing.next = now - lineTime;
+    lineTime = now;
+    lines++;
+    if (line == AT_LINE_ERROR) break;
+    if (line == cmd.endLine || (cmd.lines > 0 && lines >= cmd.lines)) { complete = true; break; }
+  }
+  echoPort->println();
+  if (ownSession) endSession();
+  //  Count the time to the first line in the latency histogram, or the timeout.
+  if (lines > 0) latency.add(cmd.type, timing.response);
+  else latency.addTimeout(cmd.type);
+
+  if (!complete) {
+    if (lines == 0) echoPort->println(F(" - ATEngine.run: Error: No response"));  //  Response timeout.
+    else echoPort->println(F(" - ATEngine.run: Error: Unknown response"));
+    return false;
+  }
+  if (cmd.parse && !cmd.parse(parser, result)) {
+    echoPort->println(F(" - ATEngine.run: Error: Invalid response"));
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,108 @@
+//  AT command engine shared by the Wisol and Akeru drivers.  Each command is a
+//  descriptor in flash: the command literal, a suffix after the argument, when the
+//  response is complete, the timeout, the latency histogram type and a callback to
+//  parse the response.  The engine writes the command, reads the response through
+//  ATParser in one loop with one buffer, and keeps the timing, latency histogram,
+//  capture hook and logging for both drivers.  Commands sent between beginSession()
+//  and endSession() share one serial session.
+#ifndef UNABIZ_ARDUINO_ATENGINE_H
+#define UNABIZ_ARDUINO_ATENGINE_H
+
+#ifdef ARDUINO
+  #if (ARDUINO >= 100)
+    #include <Arduino.h>
+  #else  //  ARDUINO >= 100
+    #include <WProgram.h>
+  #endif  //  ARDUINO  >= 100
+#endif  //  ARDUINO
+
+#include "SerialPort.h"
+#include "ATParser.h"
+#include "Histogram.h"
+
+//  Parse the completed response into result, e.g. a String or an int.
+//  Return false if the response is not valid.
+typedef bool (*ATParse)(const ATParser &response, void *result);
+
+//  Descriptor for an AT command.  Declare descriptors PROGMEM, with the literals in
+//  PROGMEM too: the engine copies the descriptor out of flash for each command.
+struct ATCommand {
+  const char *command;  //  Command literal in flash, e.g. "AT$T?".  Followed by the argument, if any.
+  const char *suffix;  //  Literal in flash after the argument, e.g. ",1", or 0.
+  uint8_t lines;  //  Response is complete after this many lines, e.g. 1 for "OK".  0 to wait for endLine.
+  uint8_t endLine;  //  ATLine that completes the response, e.g. AT_LINE_OK.  AT_LINE_NONE to count lines.
+  unsigned long timeout;  //  Milliseconds to wait for the response.
+  uint8_t type;  //  CommandType for the latency histogram.
+  ATParse parse;  //  Called when the response is complete, or 0.
+};
+
+//  One command of a pipelined sequence for ATEngine::runAll(): the command, where to
+//  parse its response, and its argument (or 0).
+struct ATStep {
+  const ATCommand *command;
+  void *result;
+  const char *argument;
+};
+
+//  Standard parse callbacks for the first data line of the response.
+bool atParseString(const ATParser &response, void *result);  //  String *result
+bool atParseInt(const ATParser &response, void *result);  //  int *result
+
+//  Timing of the last command in milliseconds.
+struct ATTiming {
+  uint16_t transmit;  //  Writing the command to the module.
+  uint32_t response;  //  From the end of the command until the first response line.
+  uint32_t next;  //  From the first response line to the second, e.g. OK to downlink.
+  uint16_t bytesSent;
+  uint16_t bytesReceived;
+};
+
+class ATEngine
+{
+public:
+  //  The command is followed by end, e.g. "\r".  Each byte sent is followed by a
+  //  pause of pacing milliseconds.  If skipEcho is true, the module echoes each
+  //  byte and the echo is dropped.
+  ATEngine(SIGFOX_SERIAL_PORT *port, unsigned long bitsPerSecond, const char *end,
+           uint8_t pacing, bool skipEcho);
+  //  Send the command with the argument (in RAM, or 0) and parse the response into
+  //  result.  Return true if the response is complete and valid.
+  bool run(const ATCommand *command, void *result = 0, const char *argument = 0);
+  //  Run the commands back to back in one session, writing each command as soon as
+  //  the previous response is complete.  Stops at the first failure.  Return the
+  //  number of commands that succeeded.
+  uint8_t runAll(const ATStep *steps, uint8_t count);
+  //  Find the UART rate of the module: run the probe command at the current rate,
+  //  then at the other common rates until it succeeds.  Return true if found.
+  bool detectBitsPerSecond(const ATCommand *probe);
+  unsigned long getBitsPerSecond() const { return bitsPerSecond; }
+  void setBitsPerSecond(unsigned long bps) { endSession(); bitsPerSecond = bps; }
+  bool beginSession();  //  Open the serial port and wait for the module.  False if the port fails.
+  void endSession();  //  Close the serial port.
+  bool inSession() const { return session; }
+  const ATParser &getResponse() const { return parser; }  //  Response to the last command.
+  const ATTiming &getTiming() const { return timing; }  //  Timing of the last command.
+  LatencyHistogram &getLatency() { return latency; }  //  Response latency of all commands by type.
+  SIGFOX_SERIAL_PORT *getPort() { return serialPort; }
+  void setEchoPort(Print *port) { echoPort = port; }  //  Log the commands and responses here.
+  void setCaptureHook(SerialCaptureHook hook, void *context) { captureHook = hook; captureContext = context; }
+
+private:
+  void writeText(const char *text, bool flash);
+  void writeByte(uint8_t ch);
+
+  SIGFOX_SERIAL_PORT *serialPort;
+  unsigned long bitsPerSecond;
+  const char *end;
+  uint8_t pacing;
+  bool skipEcho;
+  bool session;
+  ATParser parser;
+  ATTiming timing;
+  LatencyHistogram latency;
+  Print *echoPort;
+  SerialCaptureHook captureHook;
+  void *captureContext;
+};
+
+#endif  //  UNABIZ_ARDUINO_ATENGINE_H
@@ -0,0 +1,68 @@
+//  Streaming parser for AT command responses.
+#ifdef ARDUINO
+  #if (ARDUINO >= 100)
+    #include <Arduino.h>
+  #else  //  ARDUINO >= 100
+    #include <WProgram.h>
+  #endif  //  ARDUINO  >= 100
+#endif  //  ARDUINO
+
+#include "ATParser.h"
+#include "Hex.h"
+
+void ATParser::reset() {
+  lineLength = dataLength = downlinkLength = 0;
+  data[0] = 0;
+  downlinkLine = false;
+  highNibble = 0xff;
+  last = AT_LINE_NONE;
+}
+
+uint8_t ATParser::feed(uint8_t ch) {
+  //  Lines end with '\r' or '\n'.  Empty lines between them are skipped.
+  if (ch == '\r' || ch == '\n') return endLine();
+  if (downlinkLine) {
+    //  Decode the downlink hex digits as they arrive, skipping the spaces.
+    const uint8_t nibble = hexDigitToNibble((char) ch);
+    if (nibble == 0xff || downlinkLength >= AT_DOWNLINK_MAX) return AT_LINE_NONE;
+    if (highNibble == 0xff) { highNibble = nibble; return AT_LINE_NONE; }
+    downlink[downlinkLength++] = (uint8_t) ((highNibble << 4) | nibble);
+    highNibble = 0xff;
+    return AT_LINE_NONE;
+  }
+  if (lineLength < AT_LINE_MAX - 1) line[lineLength++] = (char) ch;
+  if (ch == '=' && (isLine("RX=") || isLine("+RX="))) {
+    downlinkLine = true;
+    downlinkLength = 0;
+    highNibble = 0xff;
+  }
+  return AT_LINE_NONE;
+}
+
+uint8_t ATParser::endLine() {
+  //  Classify the line that just ended.
+  uint8_t type;
+  if (downlinkLine) type = AT_LINE_DOWNLINK;
+  else if (lineLength == 0) return AT_LINE_NONE;
+  else if (isLine("OK")) type = AT_LINE_OK;
+  else if (isLine("ERROR")) type = AT_LINE_ERROR;
+  else if (isLine("+RX END")) type = AT_LINE_DOWNLINK_END;
+  else {
+    type = AT_LINE_DATA;
+    if (dataLength == 0) {
+      memcpy(data, line, lineLength);
+      dataLength = lineLength;
+      data[dataLength] = 0;
+    }
+  }
+  lineLength = 0;
+  downlinkLine = false;
+  last = type;
+  return type;
+}
+
+bool ATParser::isLine(const char *keyword) const {
+  //  Return true if the line so far is the keyword.
+  const size_t length = strlen(keyword);
+  return lineLength == length && memcmp(line, keyword, length) == 0;
+}
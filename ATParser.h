@@ -0,0 +1,59 @@
+//  Streaming parser for AT command responses, e.g. from the TD1208 in Akeru.
+//  Bytes are fed one at a time as they arrive from the module.  Each byte costs a
+//  few comparisons and no allocation: lines are kept in a fixed buffer, matched
+//  against "OK", "ERROR" and "+RX END" when they end, and the hex bytes of
+//  "RX=" / "+RX=" downlink lines are decoded as they arrive.  The caller sees
+//  the type of each completed line, so it can stop reading at "OK" without
+//  searching the whole response for every byte.
+#ifndef UNABIZ_ARDUINO_ATPARSER_H
+#define UNABIZ_ARDUINO_ATPARSER_H
+
+#ifdef ARDUINO
+  #if (ARDUINO >= 100)
+    #include <Arduino.h>
+  #else  //  ARDUINO >= 100
+    #include <WProgram.h>
+  #endif  //  ARDUINO  >= 100
+#endif  //  ARDUINO
+
+//  Types of response lines returned by ATParser::feed().
+enum ATLine {
+  AT_LINE_NONE = 0,  //  Line not complete yet, or empty line.
+  AT_LINE_DATA = 1,  //  Any other line, e.g. "920800000".  The first one is kept.
+  AT_LINE_OK = 2,  //  "OK"
+  AT_LINE_ERROR = 3,  //  "ERROR"
+  AT_LINE_DOWNLINK = 4,  //  "RX=01 23 45 67 89 AB CD EF" or "+RX=...", decoded to bytes.
+  AT_LINE_DOWNLINK_END = 5  //  "+RX END", ends the TD1208 downlink.
+};
+
+const uint8_t AT_LINE_MAX = 40;  //  Longer lines are truncated.
+const uint8_t AT_DOWNLINK_MAX = 8;  //  SIGFOX downlinks are 8 bytes.
+
+class ATParser
+{
+public:
+  ATParser() { reset(); }
+  void reset();  //  Start parsing a new response.
+  uint8_t feed(uint8_t ch);  //  Parse the byte.  Returns the ATLine completed by this byte.
+  uint8_t getLast() const { return last; }  //  Last ATLine completed, AT_LINE_NONE if none.
+  const char *getData() const { return data; }  //  First data line, "" if none.
+  uint8_t getDataLength() const { return dataLength; }
+  const uint8_t *getDownlink() const { return downlink; }  //  Bytes of the last downlink line.
+  uint8_t getDownlinkLength() const { return downlinkLength; }
+
+private:
+  uint8_t endLine();
+  bool isLine(const char *keyword) const;
+
+  char line[AT_LINE_MAX];  //  Line received so far, not terminated.
+  uint8_t lineLength;
+  char data[AT_LINE_MAX];  //  First data line, terminated.
+  uint8_t dataLength;
+  uint8_t downlink[AT_DOWNLINK_MAX];
+  uint8_t downlinkLength;
+  bool downlinkLine;  //  True if decoding the hex bytes of a downlink line.
+  uint8_t highNibble;  //  0xff if the next hex digit is the high nibble of a byte.
+  uint8_t last;
+};
+
+#endif  //  UNABIZ_ARDUINO_ATPARSER_H
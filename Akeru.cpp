@@ -28,7 +28,7 @@
   #ifdef CLION
     #include <src/SoftwareSerial.h>
   #else  //  CLION
-		#ifndef BEAN_BEAN_BEAN_H
+		#if !defined(BEAN_BEAN_BEAN_H) && (!defined(SIGFOX_SERIAL_PORT) || defined(SIGFOX_SERIAL_SOFTWARE))
     	#include <SoftwareSerial.h>
 		#endif  //  BEAN_BEAN_BEAN_H
   #endif  //  CLION
@@ -37,18 +37,100 @@
 #ifndef BEAN_BEAN_BEAN_H  //  Not supported on Bean+
 #include "SIGFOX.h"
 #include "Akeru.h"
+#include "Hex.h"
 
 static NullPort nullPort2;
 
+//  Parse callbacks for the responses.
+static bool parseVoltage(const ATParser &response, void *result)
+{
+	//  Returns the response "3.28".
+	if (response.getDataLength() == 0) return false;
+	*(float *) result = atof(response.getData());
+	return true;
+}
+
+static bool parseDownlink(const ATParser &response, void *result)
+{
+	//  Return the downlink bytes from the "+RX=" line as hex digits.
+	if (response.getDownlinkLength() == 0) return false;
+	char hex[AT_DOWNLINK_MAX * 2 + 1];
+	bytesToHex(response.getDownlink(), response.getDownlinkLength(), hex);
+	hex[response.getDownlinkLength() * 2] = 0;
+	*(String *) result = hex;
+	return true;
+}
+
+//  AT commands for the TD1208, run by ATEngine.  Each response ends with "OK",
+//  except for the downlink which ends with "+RX END".
+static const char textAT[] PROGMEM = ATCOMMAND;
+static const char textID[] PROGMEM = ATID;
+static const char textHardware[] PROGMEM = ATHARDWARE;
+static const char textFirmware[] PROGMEM = ATFIRMWARE;
+static const char textTemperature[] PROGMEM = ATTEMPERATURE;
+static const char textVoltage[] PROGMEM = ATVOLTAGE;
+static const char textPower[] PROGMEM = ATPOWER;
+static const char textGetPower[] PROGMEM = "?";
+static const char textSetPower[] PROGMEM = "=";
+static const char textDownlink[] PROGMEM = ATDOWNLINK;
+static const char textSigfoxTX[] PROGMEM = ATSIGFOXTX;
+static const char textTDLANTX[] PROGMEM = ATTDLANTX;
+static const char textGetFrequency[] PROGMEM = ATGET_FREQUENCY;
+static const char textSetFrequencySG[] PROGMEM = ATSET_FREQUENCY_SG;
+static const char textSetFrequencyETSI[] PROGMEM = ATSET_FREQUENCY_ETSI;
+static const char textWriteSettings[] PROGMEM = ATWRITE_SETTINGS;
+static const char textReboot[] PROGMEM = ATREBOOT;
+static const char textModel[] PROGMEM = ATMODEL;
+static const char textRelease[] PROGMEM = ATRELEASE;
+static const char textBaseband[] PROGMEM = ATBASEBAND;
+static const char textRFPart[] PROGMEM = ATRF_PART;
+static const char textRFRevision[] PROGMEM = ATRF_REVISION;
+static const char textPowerActive[] PROGMEM = ATPOWER_ACTIVE;
+static const char textLibrary[] PROGMEM = ATLIBRARY;
+
+#define AKERU_COMMAND(name, text, type, parse) \
+  static const ATCommand name PROGMEM = { text, 0, 0, AT_LINE_OK, ATCOMMAND_TIMEOUT, type, parse };
+AKERU_COMMAND(cmdAT, textAT, COMMAND_OTHER, 0)
+AKERU_COMMAND(cmdID, textID, COMMAND_ID, atParseString)
+AKERU_COMMAND(cmdHardware, textHardware, COMMAND_OTHER, atParseString)
+AKERU_COMMAND(cmdFirmware, textFirmware, COMMAND_OTHER, atParseString)
+AKERU_COMMAND(cmdTemperature, textTemperature, COMMAND_SENSOR, atParseInt)
+AKERU_COMMAND(cmdVoltage, textVoltage, COMMAND_SENSOR, parseVoltage)
+AKERU_COMMAND(cmdGetFrequency, textGetFrequency, COMMAND_OTHER, atParseString)
+AKERU_COMMAND(cmdSetFrequencySG, textSetFrequencySG, COMMAND_OTHER, atParseString)
+AKERU_COMMAND(cmdSetFrequencyETSI, textSetFrequencyETSI, COMMAND_OTHER, atParseString)
+AKERU_COMMAND(cmdWriteSettings, textWriteSettings, COMMAND_OTHER, atParseString)
+AKERU_COMMAND(cmdReboot, textReboot, COMMAND_OTHER, atParseString)
+AKERU_COMMAND(cmdModel, textModel, COMMAND_OTHER, atParseString)
+AKERU_COMMAND(cmdRelease, textRelease, COMMAND_OTHER, atParseString)
+AKERU_COMMAND(cmdBaseband, textBaseband, COMMAND_OTHER, atParseString)
+AKERU_COMMAND(cmdRFPart, textRFPart, COMMAND_OTHER, atParseString)
+AKERU_COMMAND(cmdRFRevision, textRFRevision, COMMAND_OTHER, atParseString)
+AKERU_COMMAND(cmdPowerActive, textPowerActive, COMMAND_OTHER, atParseString)
+AKERU_COMMAND(cmdLibrary, textLibrary, COMMAND_OTHER, atParseString)
+static const ATCommand cmdGetPower PROGMEM =  //  ATS302?
+  { textPower, textGetPower, 0, AT_LINE_OK, ATCOMMAND_TIMEOUT, COMMAND_OTHER, atParseInt };
+static const ATCommand cmdSetPower PROGMEM =  //  ATS302=power, power is the argument.
+  { textPower, 0, 0, AT_LINE_OK, ATCOMMAND_TIMEOUT, COMMAND_PRESEND, 0 };
+static const ATCommand cmdSigfoxTX PROGMEM =
+  { textSigfoxTX, 0, 0, AT_LINE_OK, ATSIGFOXTX_TIMEOUT, COMMAND_SEND, 0 };
+static const ATCommand cmdTDLANTX PROGMEM =
+  { textTDLANTX, 0, 0, AT_LINE_OK, ATSIGFOXTX_TIMEOUT, COMMAND_SEND, 0 };
+static const ATCommand cmdDownlink PROGMEM =  //  OK, then +RX BEGIN, +RX=..., +RX END.
+  { textDownlink, 0, 0, AT_LINE_DOWNLINK_END, ATSIGFOXTX_TIMEOUT + ATDOWNLINK_TIMEOUT, COMMAND_SEND, parseDownlink };
+
 Akeru::Akeru(): Akeru(AKERU_RX, AKERU_TX) {}  //  Forward to constructor below.
 
-Akeru::Akeru(unsigned int rx, unsigned int tx)
+Akeru::Akeru(unsigned int rx, unsigned int tx):
+  //  AT commands end with CRLF.  The TD1208 echoes each byte, which is dropped.
+  _engine(SIGFOX_SERIAL_OPEN(rx, tx), 9600, "\r\n", SIGFOX_SERIAL_PACING(2), true)
 {
   //  Init the module with the specified transmit and receive pins.
   //  Default to no echo.
   //Serial.begin(9600); Serial.print(String(F("Akeru.Akeru: (rx,tx)=")) + rx + ',' + tx + '\n');
-  serialPort = new SoftwareSerial(rx, tx);
+  serialPort = _engine.getPort();
   echoPort = &nullPort2;
+  _engine.setEchoPort(echoPort);
   lastEchoPort = &Serial;
   _lastSend = 0;
 }
@@ -57,6 +139,7 @@ void Akeru::echoOn()
 {
   //  Echo commands and responses to the echo port.
   echoPort = lastEchoPort;
+  _engine.setEchoPort(echoPort);
   //  echoPort->println(F("Akeru.echoOn"));
 }
 
@@ -65,12 +148,19 @@ void Akeru::echoOff()
   //  Stop echoing commands and responses to the echo port.
   lastEchoPort = echoPort;
   echoPort = &nullPort2;
+  _engine.setEchoPort(echoPort);
+}
+
+void Akeru::setCaptureHook(SerialCaptureHook hook, void *context) {
+  //  Capture the bytes sent to and received from the module.
+  _engine.setCaptureHook(hook, context);
 }
 
 void Akeru::setEchoPort(Print *port) {
   //  Set the port for sending echo output.
   lastEchoPort = echoPort;
   echoPort = port;
+  _engine.setEchoPort(echoPort);
 }
 
 void Akeru::echo(String msg) {
@@ -85,9 +175,9 @@ bool Akeru::begin()
 	delay(2000);
 	_lastSend = -1;
 	
-	// Check TD1208 communication
+	// Check TD1208 communication, at another UART rate if needed
 	if (sendAT()) return true;
-	else return false;
+	return _engine.detectBitsPerSecond(&cmdAT);
 }
 
 bool Akeru::isReady()
@@ -126,8 +216,7 @@ bool Akeru::isReady()
 
 bool Akeru::sendAT()
 {
-  String data = "";
-	return sendATCommand(ATCOMMAND, ATCOMMAND_TIMEOUT, data);
+	return sendCommand(&cmdAT);
 }
 
 bool Akeru::sendMessage(const String payload)
@@ -137,7 +226,7 @@ bool Akeru::sendMessage(const String payload)
 
   //  Construct the message.
   //  For emulation mode, send message locally to another TD module using TD LAN mode.
-	String message = _emulationMode ? ATTDLANTX : ATSIGFOXTX;
+	String message;
 	if (_emulationMode) {
     //  Emulation message format: device ID (4 bytes) + sequence number (1 byte) + payload (max 12 bytes)
     String id, pac;
@@ -151,10 +240,8 @@ bool Akeru::sendMessage(const String payload)
   if (_sequenceNumber > 255) _sequenceNumber = 0;
 
   //  Send the message.
-	String data = "";
-	if (sendATCommand(message, ATSIGFOXTX_TIMEOUT, data))
+	if (sendCommand(_emulationMode ? &cmdTDLANTX : &cmdSigfoxTX, 0, message.c_str()))
 	{
-    echoPort->println(data);
 		_lastSend = millis();
 		return true;
 	}
@@ -166,16 +253,7 @@ bool Akeru::sendMessage(const String payload)
 
 bool Akeru::getTemperature(int &temperature)
 {
-	String data = "";
-	if (sendATCommand(ATTEMPERATURE, ATCOMMAND_TIMEOUT, data))
-	{
-		temperature = (int) data.toInt();
-		return true;
-	}
-	else
-	{
-		return false;
-	}
+	return sendCommand(&cmdTemperature, &temperature);
 }
 
 bool Akeru::getID(String &id, String &pac)
@@ -185,10 +263,9 @@ bool Akeru::getID(String &id, String &pac)
   if (_id.length() > 0) {
     id = _id; pac = _pac; return true;
   }
-	String data = "";
-	if (sendATCommand(ATID, ATCOMMAND_TIMEOUT, data))
+	if (sendCommand(&cmdID, &id))
 	{
-		id = data; pac = "";  //  PAC is not available for Akene.
+		pac = "";  //  PAC is not available for Akene.
     _id = id; _pac = pac;  //  Cache for later use.
 		return true;
 	}
@@ -200,144 +277,38 @@ bool Akeru::getID(String &id, String &pac)
 
 bool Akeru::getVoltage(float &voltage)
 {
-	String data = "";
-	if (sendATCommand(ATVOLTAGE, ATCOMMAND_TIMEOUT, data))
-	{
-    //  Returns the response "3.28".
-		//  voltage = data.toFloat();
-    //  Since Bean+ doesn't support toFloat(), we convert to int and divide by the decimal place.
-    int dotPos = data.indexOf('.');
-    int divisor = 0;
-    if (dotPos >= 0) {  //  Expect 1.
-      divisor = data.length() - dotPos - 1;
-      data = data.substring(0, (unsigned int) dotPos) + data.substring((unsigned int) dotPos + 1);
-    }
-    voltage = data.toInt();
-    for (int i = 0; i < divisor; i++) {
-      voltage = voltage / 10.0;
-    }
-		return true;
-	}
-	else
-	{
-		return false;
-	}
+	//  Returns the response "3.28".
+	return sendCommand(&cmdVoltage, &voltage);
 }
 
 bool Akeru::getHardware(String &hardware)
 {
-	String data = "";
-	if (sendATCommand(ATHARDWARE, ATCOMMAND_TIMEOUT, data))
-	{
-		hardware = data;
-		return true;
-	}
-	else
-	{
-		return false;
-	}
+	return sendCommand(&cmdHardware, &hardware);
 }
 
 bool Akeru::getFirmware(String &firmware)
 {
-	String data = "";
-	if (sendATCommand(ATFIRMWARE, ATCOMMAND_TIMEOUT, data))
-	{
-		firmware = data;
-		return true;
-	}
-	else
-	{
-		return false;
-	}
+	return sendCommand(&cmdFirmware, &firmware);
 }
 
 bool Akeru::getPower(int &power)
 {	
-	String message = (String) ATPOWER + '?';
-	String data = "";
-	if (sendATCommand(message, ATCOMMAND_TIMEOUT, data))
-	{
-		power = data.toInt();
-		return true;
-	}
-	else
-	{
-		return false;
-	}
+	return sendCommand(&cmdGetPower, &power);
 }
 
 // Power value: 0...14
 bool Akeru::setPower(int power)
 {
-	String message = (String) ATPOWER + "=" + power;
-	String data = "";
-	if (sendATCommand(message, ATCOMMAND_TIMEOUT, data))
-	{
-		echoPort->println(data);
-		return true;
-	}
-	else
-	{
-		return false;
-	}
+	return sendCommand(&cmdSetPower, 0, String(power).c_str());
 }
 
 bool Akeru::receive(String &data)
 {
 	if (!isReady()) return false;
-	
-	if (sendATCommand(ATDOWNLINK, ATSIGFOXTX_TIMEOUT, data))
-	{
-		// Restart serial interface
-		serialPort->begin(9600);
-		delay(200);	
-		serialPort->flush();
-		serialPort->listen();
-		
-		// Read response 
-		String response = "";
-		
-		unsigned int startTime = millis();
-		volatile unsigned int currentTime = millis();
-		volatile char rxChar = '\0';
-
-		// RX management : two ways to break the loop
-		// - Timeout
-		// - Receive 
-		do
-		{
-			if (serialPort->available() > 0)
-			{
-				rxChar = (char)serialPort->read();
-				response.concat(rxChar);
-			}
-			currentTime = millis();
-		}while(((currentTime - startTime) < ATDOWNLINK_TIMEOUT) && response.endsWith(DOWNLINKEND) == false);
-
-		serialPort->end();
-    echoPort->println(response);
-
-		// Now that we have the full answer we can look for the received bytes
-		if (response.length() != 0)
-		{
-			// Search for transmission start
-			int index = response.indexOf("=");
-			// Get the chunk, it's 8 bytes long + separating spaces = 23 chars
-			String chunk = response.substring(index, index+24);
-			if (chunk.length() > 0)
-			{
-				// Remove the spaces
-				chunk.replace(" ", "");
-				data = chunk;
-				return true;
-			}
-		}
-	}
-	else 
-	{
-		return false;
-	}
+
+	//  Send the downlink request and keep reading in the same session until the
+	//  module sends "+RX END" after the "+RX=" line with the downlink bytes.
+	return sendCommand(&cmdDownlink, &data);
 }
 
 String Akeru::toHex(int i)
@@ -465,122 +436,10 @@ String Akeru::toHex(char *c, int length)
 	return bytes;
 }
 
-bool Akeru::sendATCommand(const String command, const int timeout, String &dataOut)
+bool Akeru::sendCommand(const ATCommand *command, void *result, const char *argument)
 {
-	// Start serial interface
-	serialPort->begin(9600);
-	delay(200);	
-	serialPort->flush();
-	serialPort->listen();
-
-	// Add CRLF to the command
-	String ATCommand = "";
-	ATCommand.concat(command);
-	ATCommand.concat("\r\n");
-  echoPort->print((String)"\n>> " + ATCommand);
-
-	// Send the command : need to write/read char by char because of echo
-	for (int i = 0; i < ATCommand.length(); ++i)
-	{
-		serialPort->print(ATCommand.c_str()[i]);
-		serialPort->read();
-	}
-  echoPort->print("<< ");
-
-	// Read response 
-	String response = "";
-	unsigned int startTime = millis();
-	volatile unsigned int currentTime = millis();
-	volatile char rxChar = '\0';
-
-	// RX management : two ways to break the loop
-	// - Timeout
-	// - Receive 
-	do
-	{
-		if (serialPort->available() > 0)
-		{
-			rxChar = (char)serialPort->read();
-			response.concat(rxChar);
-		}
-
-		currentTime = millis();
-	}while(((currentTime - startTime) < timeout) && response.endsWith(ATOK) == false);
-
-	serialPort->end();
-  String res = response;
-  while (res.length() > 0 && (res.charAt(0) == '\r' || res.charAt(0) == '\n'))
-    res = res.substring(1);  //  Strip off leading newline.
-  echoPort->print(res);
-
-	// Split the response
-	int index = 0;
-	String firstData = "";
-	String secondData = "";
-
-	if (response.length() != 0)
-	{
-		// Split CRLF
-		do
-		{
-			// Save previous index
-			int previous = index;
-
-			// Get next index
-			index = response.indexOf("\r\n", index);
-
-			// Check that index change
-			if (previous != index)
-			{
-				// Get the chunk
-				String chunk = response.substring(previous+1, index);
-				if (chunk.length() > 0)
-				{
-					// Remove \r\n 
-					chunk.replace("\r\n", "");
-					
-					if (firstData != "")
-					{
-						secondData = chunk;
-					}
-					else if (firstData == "" && secondData == "")
-					{
-						firstData = chunk;
-					}
-					else
-					{
-						echoPort->println("ERROR on rx frame");
-						return false;
-					}
-				}
-			}
-
-			// Increment index
-			if (index >= 0) index++;
-		
-		} while (index < response.length() && index >= 0);
-	}
-	else
-	{
-		return false;
-	}
-
-	// Check if we have data on the first string and OK on second = data + OK
-	if (firstData != "" && secondData == ATOK)
-	{
-		dataOut = firstData;
-		return true;
-	}
-	// Check if we have only an OK
-	else if (firstData == ATOK && secondData == "")
-	{
-		return true;
-	}
-	else
-	{
-		echoPort->println("Wrong AT response");
-		return false;
-	}
+	//  Run the AT command with the argument and parse the response into result.
+	return _engine.run(command, result, argument);
 }
 
 //  Singapore and Taiwan: 920.8 MHz Uplink, 922.3 MHz Downlink
@@ -590,32 +449,14 @@ bool Akeru::getFrequency(String &result)
 {
 	//  Get the frequency used for the SIGFOX module, e.g.
 	//  868130000
-	String data = "";
-	if (sendATCommand(ATGET_FREQUENCY, ATCOMMAND_TIMEOUT, data))
-	{
-		result = data;
-		return true;
-	}
-	else
-	{
-		return false;
-	}
+	return sendCommand(&cmdGetFrequency, &result);
 }
 
 bool Akeru::setFrequencySG(String &result)
 {
 	//  Set the frequency for the SIGFOX module to Singapore frequency.
 	//  Must be followed by writeSettings and reboot commands.
-	String data = "";
-	if (sendATCommand(ATSET_FREQUENCY_SG, ATCOMMAND_TIMEOUT, data))
-	{
-		result = data;
-		return true;
-	}
-	else
-	{
-		return false;
-	}
+	return sendCommand(&cmdSetFrequencySG, &result);
 }
 
 bool Akeru::setFrequencyTW(String &result)
@@ -629,46 +470,19 @@ bool Akeru::setFrequencyETSI(String &result)
 {
 	//  Set the frequency for the SIGFOX module to ETSI frequency for Europe or demo for 868 MHz base station.
 	//  Must be followed by writeSettings and reboot commands.
-	String data = "";
-	if (sendATCommand(ATSET_FREQUENCY_ETSI, ATCOMMAND_TIMEOUT, data))
-	{
-		result = data;
-		return true;
-	}
-	else
-	{
-		return false;
-	}
+	return sendCommand(&cmdSetFrequencyETSI, &result);
 }
 
 bool Akeru::writeSettings(String &result)
 {
 	//  Write frequency and other settings to flash memory of the SIGFOX module.  Must be followed by reboot command.
-	String data = "";
-	if (sendATCommand(ATWRITE_SETTINGS, ATCOMMAND_TIMEOUT, data))
-	{
-		result = data;
-		return true;
-	}
-	else
-	{
-		return false;
-	}
+	return sendCommand(&cmdWriteSettings, &result);
 }
 
 bool Akeru::reboot(String &result)
 {
 	//  Reboot the SIGFOX module.
-	String data = "";
-	if (sendATCommand(ATREBOOT, ATCOMMAND_TIMEOUT, data))
-	{
-		result = data;
-		return true;
-	}
-	else
-	{
-		return false;
-	}
+	return sendCommand(&cmdReboot, &result);
 }
 
 bool Akeru::enableEmulator(String &result)
@@ -690,106 +504,43 @@ bool Akeru::disableEmulator(String &result)
 bool Akeru::getModel(String &result)
 {
 	//  Get manufacturer and model.
-	String data = "";
-	if (sendATCommand(ATMODEL, ATCOMMAND_TIMEOUT, data))
-	{
-		result = data;
-		return true;
-	}
-	else
-	{
-		return false;
-	}
+	return sendCommand(&cmdModel, &result);
 }
 
 bool Akeru::getRelease(String &result)
 {
 	//  Get firmware release date.
-	String data = "";
-	if (sendATCommand(ATRELEASE, ATCOMMAND_TIMEOUT, data))
-	{
-		result = data;
-		return true;
-	}
-	else
-	{
-		return false;
-	}
+	return sendCommand(&cmdRelease, &result);
 }
 
 bool Akeru::getBaseband(String &result)
 {
 	//  Get baseband unique ID.
-	String data = "";
-	if (sendATCommand(ATBASEBAND, ATCOMMAND_TIMEOUT, data))
-	{
-		result = data;
-		return true;
-	}
-	else
-	{
-		return false;
-	}
+	return sendCommand(&cmdBaseband, &result);
 }
 
 bool Akeru::getRFPart(String &result)
 {
 	///  Get RF chip part number.
-	String data = "";
-	if (sendATCommand(ATRF_PART, ATCOMMAND_TIMEOUT, data))
-	{
-		result = data;
-		return true;
-	}
-	else
-	{
-		return false;
-	}
+	return sendCommand(&cmdRFPart, &result);
 }
 
 bool Akeru::getRFRevision(String &result)
 {
 	//  Get RF chip revision number.
-	String data = "";
-	if (sendATCommand(ATRF_REVISION, ATCOMMAND_TIMEOUT, data))
-	{
-		result = data;
-		return true;
-	}
-	else
-	{
-		return false;
-	}
+	return sendCommand(&cmdRFRevision, &result);
 }
 
 bool Akeru::getPowerActive(String &result)
 {
 	//  Get module RF active power supply voltage
-	String data = "";
-	if (sendATCommand(ATPOWER_ACTIVE, ATCOMMAND_TIMEOUT, data))
-	{
-		result = data;
-		return true;
-	}
-	else
-	{
-		return false;
-	}
+	return sendCommand(&cmdPowerActive, &result);
 }
 
 bool Akeru::getLibraryVersion(String &result)
 {
 	//  Get RF library version.
-	String data = "";
-	if (sendATCommand(ATLIBRARY, ATCOMMAND_TIMEOUT, data))
-	{
-		result = data;
-		return true;
-	}
-	else
-	{
-		return false;
-	}
+	return sendCommand(&cmdLibrary, &result);
 }
 
 // For convenience, allow sending of a text string with automatic encoding into bytes.  Max 12 characters allowed.
@@ -32,7 +32,7 @@
   #ifdef CLION
     #include <src/SoftwareSerial.h>
   #else  //  CLION
-		#ifndef BEAN_BEAN_BEAN_H
+		#if !defined(BEAN_BEAN_BEAN_H) && (!defined(SIGFOX_SERIAL_PORT) || defined(SIGFOX_SERIAL_SOFTWARE))
     	#include <SoftwareSerial.h>
 		#endif  //  BEAN_BEAN_BEAN_H
   #endif  //  CLION
@@ -40,6 +40,9 @@
 #else  //  ARDUINO
 #endif  //  ARDUINO
 
+#include "SerialPort.h"
+#include "ATEngine.h"
+
 #define ATOK "OK"
 #define ATCOMMAND "AT"
 #define ATID "ATI7"
@@ -96,13 +99,16 @@ class Akeru
     void echoOn();  //  Turn on send/receive echo.
     void echoOff();  //  Turn off send/receive echo.
     void setEchoPort(Print *port);  //  Set the port for sending echo output.
+    void setCaptureHook(SerialCaptureHook hook, void *context);  //  Capture the bytes sent and received.  0 to stop.
 		void echo(String msg);  //  Echo the debug message.
     bool isReady();
+    LatencyHistogram &getLatency() { return _engine.getLatency(); }  //  Response latency of all commands, to dump or pack.
+    unsigned long getBitsPerSecond() const { return _engine.getBitsPerSecond(); }  //  UART rate found by begin().
     bool sendMessage(const String payload);  //  Send the payload of hex digits to the network, max 12 bytes.
 		bool sendString(const String str);  //  Sending a text string, max 12 characters allowed.
     bool receive(String &data);  //  Receive a message.
-    bool enterCommandMode() {}  //  Enter Command Mode for sending module commands, not data.
-    bool exitCommandMode() {}  //  Exit Command Mode so we can send data.
+    bool enterCommandMode() { return true; }  //  Enter Command Mode for sending module commands, not data.
+    bool exitCommandMode() { return true; }  //  Exit Command Mode so we can send data.
 
     //  Commands for the module, must be run in Command Mode.
     bool getEmulator(int &result)  //  Return 0 if emulator mode disabled, else return 1.
@@ -154,8 +160,9 @@ class Akeru
 
 private:
     bool sendAT();
-		bool sendATCommand(const String command, const int timeout, String &dataOut);
-		SoftwareSerial* serialPort;
+		bool sendCommand(const ATCommand *command, void *result = 0, const char *argument = 0);
+		ATEngine _engine;  //  Sends the AT commands and parses the responses.
+		SIGFOX_SERIAL_PORT* serialPort;
     Print *echoPort;  //  Port for sending echo output.  Defaults to Serial.
     Print *lastEchoPort;  //  Last port used for sending echo output.
     bool _emulationMode = false;  //  True if using emulation (TD LAN) mode.
@@ -56,10 +56,14 @@ http://arduiniana.org.
 //
 // Statics
 //
-BeanSoftwareSerial *BeanSoftwareSerial::active_object = 0;
-char BeanSoftwareSerial::_receive_buffer[_SS_MAX_RX_BUFF];
-volatile uint8_t BeanSoftwareSerial::_receive_buffer_tail = 0;
-volatile uint8_t BeanSoftwareSerial::_receive_buffer_head = 0;
+BeanSoftwareSerialBase *BeanSoftwareSerialBase::listeners[_SS_MAX_LISTENERS];
+BeanSoftwareSerialBase * volatile BeanSoftwareSerialBase::tx_object = 0;
+volatile uint8_t BeanSoftwareSerialBase::tx_state = 0;
+uint8_t BeanSoftwareSerialBase::tx_byte = 0;
+uint8_t BeanSoftwareSerialBase::tx_gap = 0;
+uint8_t BeanSoftwareSerialBase::tx_saved_tccr2a = 0;
+uint8_t BeanSoftwareSerialBase::tx_saved_tccr2b = 0;
+uint8_t BeanSoftwareSerialBase::tx_saved_ocr2a = 0;
 
 //
 // Debugging
@@ -85,49 +89,83 @@ inline void DebugPulse(uint8_t pin, uint8_t count)
 //
 
 /* static */ 
-inline void BeanSoftwareSerial::tunedDelay(uint16_t delay) {
+inline void BeanSoftwareSerialBase::tunedDelay(uint16_t delay) {
   _delay_loop_2(delay);
 }
 
-// This function sets the current object as the "listening"
-// one and returns true if it replaces another 
-bool BeanSoftwareSerial::listen()
+// This function adds the current object to the "listening" ones
+// and returns true if it was not listening before.  Other ports keep
+// listening and keep their buffered data.  If all listener slots are
+// taken, the oldest listener is replaced.
+bool BeanSoftwareSerialBase::listen()
 {
   if (!_rx_delay_stopbit)
     return false;
 
-  if (active_object != this)
-  {
-    if (active_object)
-      active_object->stopListening();
-
-    _buffer_overflow = false;
-    _receive_buffer_head = _receive_buffer_tail = 0;
-    active_object = this;
+  if (isListening())
+    return false;
 
-    setRxIntMsk(true);
-    return true;
+  uint8_t oldSREG = SREG;
+  cli();
+  uint8_t slot = 0;
+  while (slot < _SS_MAX_LISTENERS && listeners[slot])
+    ++slot;
+  if (slot == _SS_MAX_LISTENERS)
+  {
+    listeners[0]->setRxIntMsk(false);
+    for (slot = 0; slot + 1 < _SS_MAX_LISTENERS; ++slot)
+      listeners[slot] = listeners[slot + 1];
   }
+  _buffer_overflow = false;
+  _receive_buffer_head = _receive_buffer_tail = 0;
+  listeners[slot] = this;
+  // While another port transmits, stopTransmit() enables the interrupt
+  if (!tx_object || tx_object == this)
+    setRxIntMsk(true);
+  SREG = oldSREG;
+  return true;
+}
 
+bool BeanSoftwareSerialBase::isListening()
+{
+  for (uint8_t i = 0; i < _SS_MAX_LISTENERS; ++i)
+    if (listeners[i] == this)
+      return true;
   return false;
 }
 
 // Stop listening. Returns true if we were actually listening.
-bool BeanSoftwareSerial::stopListening()
+bool BeanSoftwareSerialBase::stopListening()
 {
-  if (active_object == this)
+  for (uint8_t i = 0; i < _SS_MAX_LISTENERS; ++i)
   {
+    if (listeners[i] != this)
+      continue;
+    uint8_t oldSREG = SREG;
+    cli();
     setRxIntMsk(false);
-    active_object = NULL;
+    for (; i + 1 < _SS_MAX_LISTENERS; ++i)
+      listeners[i] = listeners[i + 1];
+    listeners[_SS_MAX_LISTENERS - 1] = NULL;
+    SREG = oldSREG;
     return true;
   }
   return false;
 }
 
+void BeanSoftwareSerialBase::resetStats()
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  _overflow_count = 0;
+  _high_water = 0;
+  SREG = oldSREG;
+}
+
 //
 // The receive routine called by the interrupt handler
 //
-void BeanSoftwareSerial::recv()
+void BeanSoftwareSerialBase::recv()
 {
 
 #if GCC_VERSION < 40302
@@ -175,17 +213,22 @@ void BeanSoftwareSerial::recv()
       d = ~d;
 
     // if buffer full, set the overflow flag and return
-    uint8_t next = (_receive_buffer_tail + 1) % _SS_MAX_RX_BUFF;
+    uint8_t next = (_receive_buffer_tail + 1) & _receive_mask;
     if (next != _receive_buffer_head)
     {
       // save new data in buffer: tail points to where byte goes
       _receive_buffer[_receive_buffer_tail] = d; // save new byte
       _receive_buffer_tail = next;
+      uint8_t used = (next - _receive_buffer_head) & _receive_mask;
+      if (used > _high_water)
+        _high_water = used;
     } 
     else 
     {
       DebugPulse(_DEBUG_PIN1, 1);
       _buffer_overflow = true;
+      if (_overflow_count != 0xffff)
+        ++_overflow_count;
     }
 
     // skip the stop bit
@@ -213,21 +256,124 @@ void BeanSoftwareSerial::recv()
 #endif
 }
 
-uint8_t BeanSoftwareSerial::rx_pin_read()
+uint8_t BeanSoftwareSerialBase::rx_pin_read()
 {
   return *_receivePortRegister & _receiveBitMask;
 }
 
+void BeanSoftwareSerialBase::tx_pin_write(uint8_t pin_state)
+{
+  if (_inverse_logic ? !pin_state : pin_state)
+    *_transmitPortRegister |= _transmitBitMask;
+  else
+    *_transmitPortRegister &= ~_transmitBitMask;
+}
+
+#ifdef _SS_TIMER_TX
+//
+// The transmit routine called by the Timer2 compare interrupt, once per bit
+//
+void BeanSoftwareSerialBase::transmitBit()
+{
+  uint8_t state = tx_state;
+
+  // Write each of the 8 bits, LSB first
+  if (state >= 1 && state <= 8)
+  {
+    tx_pin_write(tx_byte & 1);
+    tx_byte >>= 1;
+    tx_state = state + 1;
+    return;
+  }
+
+  // Write the stop bit
+  if (state == 9)
+  {
+    tx_pin_write(HIGH);
+    tx_state = 10;
+    return;
+  }
+
+  // Stop bit done.  Leave the line idle while the echo comes back.
+  if (state != 0 && state < 10 + tx_gap)
+  {
+    tx_state = state + 1;
+    return;
+  }
+
+  // Queue empty: give the timer back and free it for the other ports
+  if (_transmit_buffer_head == _transmit_buffer_tail)
+  {
+    stopTransmit();
+    return;
+  }
+
+  // Write the start bit of the next byte
+  tx_byte = _transmit_buffer[_transmit_buffer_head];
+  _transmit_buffer_head = (_transmit_buffer_head + 1) & _transmit_mask;
+  tx_pin_write(LOW);
+  tx_state = 1;
+}
+
+// Take Timer2 and send the start bit of the first queued byte.
+// Must be called with interrupts off.
+void BeanSoftwareSerialBase::startTransmit()
+{
+  tx_object = this;
+  tx_state = 0;
+  tx_gap = isListening() ? 10 : 0;  // One character for the echo
+
+  // A byte received by another port would hold interrupts off for a whole
+  // character and stretch our bits, so the other ports stop listening
+  for (uint8_t i = 0; i < _SS_MAX_LISTENERS && listeners[i]; ++i)
+    if (listeners[i] != this)
+      listeners[i]->setRxIntMsk(false);
+
+  tx_saved_tccr2a = TCCR2A;
+  tx_saved_tccr2b = TCCR2B;
+  tx_saved_ocr2a = OCR2A;
+  TCCR2B = 0;
+  TCCR2A = _BV(WGM21);  // CTC mode: count up to OCR2A and restart
+  TCNT2 = 0;
+  OCR2A = _tx_timer_compare;
+  TIFR2 = _BV(OCF2A);
+  TIMSK2 |= _BV(OCIE2A);
+  transmitBit();
+  TCCR2B = _tx_timer_clock;
+}
+
+// Restore Timer2 and let the other ports listen again.
+// Called from the interrupt when the queue is empty.
+void BeanSoftwareSerialBase::stopTransmit()
+{
+  TIMSK2 &= ~_BV(OCIE2A);
+  TCCR2B = 0;
+  TCCR2A = tx_saved_tccr2a;
+  OCR2A = tx_saved_ocr2a;
+  TCCR2B = tx_saved_tccr2b;
+  tx_object = NULL;
+
+  for (uint8_t i = 0; i < _SS_MAX_LISTENERS && listeners[i]; ++i)
+    if (listeners[i] != this)
+      listeners[i]->setRxIntMsk(true);
+}
+#endif // _SS_TIMER_TX
+
 //
 // Interrupt handling
 //
 
 /* static */
-inline void BeanSoftwareSerial::handle_interrupt()
+inline void BeanSoftwareSerialBase::handle_interrupt()
 {
-  if (active_object)
+  // Pins may share the handler, so let every listener check its own
+  // pin: recv() returns at once if there is no start bit.
+  for (uint8_t i = 0; i < _SS_MAX_LISTENERS && listeners[i]; ++i)
   {
-    active_object->recv();
+    // While a port transmits, only it receives (its echo)
+    if (tx_object && listeners[i] != tx_object)
+      continue;
+    listeners[i]->recv();
   }
 }
 
@@ -257,16 +403,45 @@ ISR(PCINT3_vect, ISR_ALIASOF(PCINT0_vect));
 
 #endif  //  BEAN_BEAN_BEAN_H
 
+#ifdef _SS_TIMER_TX
+/* static */
+inline void BeanSoftwareSerialBase::handle_tx_interrupt()
+{
+  if (tx_object)
+  {
+    tx_object->transmitBit();
+  }
+}
+
+ISR(TIMER2_COMPA_vect)
+{
+  BeanSoftwareSerialBase::handle_tx_interrupt();
+}
+#endif // _SS_TIMER_TX
+
 //
 // Constructor
 //
-BeanSoftwareSerial::BeanSoftwareSerial(uint8_t receivePin, uint8_t transmitPin, bool inverse_logic /* = false */) :
+BeanSoftwareSerialBase::BeanSoftwareSerialBase(uint8_t receivePin, uint8_t transmitPin, bool inverse_logic,
+  char *buffer, uint16_t bufferSize, char *transmitBuffer, uint16_t transmitBufferSize) :
   _rx_delay_centering(0),
   _rx_delay_intrabit(0),
   _rx_delay_stopbit(0),
   _tx_delay(0),
   _buffer_overflow(false),
-  _inverse_logic(inverse_logic)
+  _inverse_logic(inverse_logic),
+  _receive_buffer(buffer),
+  _receive_mask(bufferSize - 1),
+  _receive_buffer_tail(0),
+  _receive_buffer_head(0),
+  _overflow_count(0),
+  _high_water(0),
+  _transmit_buffer(transmitBuffer),
+  _transmit_mask(transmitBufferSize - 1),
+  _transmit_buffer_tail(0),
+  _transmit_buffer_head(0),
+  _tx_timer_clock(0),
+  _tx_timer_compare(0)
 {
   setTX(transmitPin);
   setRX(receivePin);
@@ -275,19 +450,19 @@ BeanSoftwareSerial::BeanSoftwareSerial(uint8_t receivePin, uint8_t transmitPin,
   //  For Bean we use PinChangeInt library to set the interrupt handler.
   //  With the standard SoftwareSerial, Bean+ can send data but no data
   //  will be received.  This code change fixes the data receiving.
-  attachPinChangeInterrupt(receivePin, BeanSoftwareSerial::handle_interrupt, CHANGE);
+  attachPinChangeInterrupt(receivePin, BeanSoftwareSerialBase::handle_interrupt, CHANGE);
 #endif  //  BEAN_BEAN_BEAN_H
 }
 
 //
 // Destructor
 //
-BeanSoftwareSerial::~BeanSoftwareSerial()
+BeanSoftwareSerialBase::~BeanSoftwareSerialBase()
 {
   end();
 }
 
-void BeanSoftwareSerial::setTX(uint8_t tx)
+void BeanSoftwareSerialBase::setTX(uint8_t tx)
 {
   // First write, then set output. If we do this the other way around,
   // the pin would be output low for a short while before switching to
@@ -300,7 +475,7 @@ void BeanSoftwareSerial::setTX(uint8_t tx)
   _transmitPortRegister = portOutputRegister(port);
 }
 
-void BeanSoftwareSerial::setRX(uint8_t rx)
+void BeanSoftwareSerialBase::setRX(uint8_t rx)
 {
   pinMode(rx, INPUT);
   if (!_inverse_logic)
@@ -311,7 +486,7 @@ void BeanSoftwareSerial::setRX(uint8_t rx)
   _receivePortRegister = portInputRegister(port);
 }
 
-uint16_t BeanSoftwareSerial::subtract_cap(uint16_t num, uint16_t sub) {
+uint16_t BeanSoftwareSerialBase::subtract_cap(uint16_t num, uint16_t sub) {
   if (num > sub)
     return num - sub;
   else
@@ -322,8 +497,9 @@ uint16_t BeanSoftwareSerial::subtract_cap(uint16_t num, uint16_t sub) {
 // Public methods
 //
 
-void BeanSoftwareSerial::begin(long speed)
+void BeanSoftwareSerialBase::begin(long speed)
 {
+  waitForTransmit();
   _rx_delay_centering = _rx_delay_intrabit = _rx_delay_stopbit = _tx_delay = 0;
 
   // Precalculate the various delays, in number of 4-cycle delays
@@ -336,6 +512,26 @@ void BeanSoftwareSerial::begin(long speed)
   // timings are the most critical (deviations stack 8 times)
   _tx_delay = subtract_cap(bit_delay, 15 / 4);
 
+  // Pick the Timer2 prescaler that gives one compare match per bit.  At
+  // high speeds the interrupt overhead is too large, so write() bit-bangs.
+  _tx_timer_clock = 0;
+#ifdef _SS_TIMER_TX
+  uint32_t bit_ticks = F_CPU / speed;
+  if (bit_ticks >= _SS_MIN_TX_TICKS)
+  {
+    static const uint16_t prescale[] = { 1, 8, 32, 64, 128, 256, 1024 };
+    for (uint8_t i = 0; i < 7; ++i)
+    {
+      uint32_t compare = (bit_ticks + prescale[i] / 2) / prescale[i];
+      if (compare > 256)
+        continue;
+      _tx_timer_clock = i + 1;  // CS22:0
+      _tx_timer_compare = compare - 1;
+      break;
+    }
+  }
+#endif // _SS_TIMER_TX
+
   // Only setup rx when we have a valid PCINT for this pin
   if (digitalPinToPCICR(_receivePin)) {
     #if GCC_VERSION > 40800
@@ -395,7 +591,7 @@ void BeanSoftwareSerial::begin(long speed)
   listen();
 }
 
-void BeanSoftwareSerial::setRxIntMsk(bool enable)
+void BeanSoftwareSerialBase::setRxIntMsk(bool enable)
 {
     if (enable)
       *_pcint_maskreg |= _pcint_maskvalue;
@@ -403,14 +599,32 @@ void BeanSoftwareSerial::setRxIntMsk(bool enable)
       *_pcint_maskreg &= ~_pcint_maskvalue;
 }
 
-void BeanSoftwareSerial::end()
+void BeanSoftwareSerialBase::end()
 {
+  waitForTransmit();
   stopListening();
 }
 
+void BeanSoftwareSerialBase::waitForTransmit()
+{
+#ifdef _SS_TIMER_TX
+  while (tx_object == this)
+    ;
+#endif // _SS_TIMER_TX
+}
+
+int BeanSoftwareSerialBase::availableForWrite()
+{
+#ifdef _SS_TIMER_TX
+  return (uint8_t) (_transmit_buffer_head - _transmit_buffer_tail - 1) & _transmit_mask;
+#else
+  return 1;  // write() sends each byte before returning
+#endif // _SS_TIMER_TX
+}
+
 
 // Read data from buffer
-int BeanSoftwareSerial::read()
+int BeanSoftwareSerialBase::read()
 {
   if (!isListening())
     return -1;
@@ -421,25 +635,59 @@ int BeanSoftwareSerial::read()
 
   // Read from "head"
   uint8_t d = _receive_buffer[_receive_buffer_head]; // grab next byte
-  _receive_buffer_head = (_receive_buffer_head + 1) % _SS_MAX_RX_BUFF;
+  _receive_buffer_head = (_receive_buffer_head + 1) & _receive_mask;
   return d;
 }
 
-int BeanSoftwareSerial::available()
+int BeanSoftwareSerialBase::available()
 {
   if (!isListening())
     return 0;
 
-  return (_receive_buffer_tail + _SS_MAX_RX_BUFF - _receive_buffer_head) % _SS_MAX_RX_BUFF;
+  return (uint8_t) (_receive_buffer_tail - _receive_buffer_head) & _receive_mask;
 }
 
-size_t BeanSoftwareSerial::write(uint8_t b)
+// Queue the byte for the Timer2 interrupt and return, or with
+// _SS_TIMER_TX undefined, send it now
+size_t BeanSoftwareSerialBase::write(uint8_t b)
 {
   if (_tx_delay == 0) {
     setWriteError();
     return 0;
   }
 
+#ifndef _SS_TIMER_TX
+  return writeBlocking(b);
+#else
+
+  // Too fast for the timer: wait for the other ports, then bit-bang
+  if (!_tx_timer_clock)
+  {
+    while (tx_object)
+      ;
+    return writeBlocking(b);
+  }
+
+  // Wait if the queue is full or another port has the timer
+  uint8_t next = (_transmit_buffer_tail + 1) & _transmit_mask;
+  while (next == _transmit_buffer_head || (tx_object && tx_object != this))
+    ;
+
+  _transmit_buffer[_transmit_buffer_tail] = b;
+  uint8_t oldSREG = SREG;
+  cli();
+  _transmit_buffer_tail = next;
+  if (!tx_object)
+    startTransmit();
+  SREG = oldSREG;
+  return 1;
+#endif // _SS_TIMER_TX
+}
+
+// Send the byte now with busy-wait delays, with interrupts off
+size_t BeanSoftwareSerialBase::writeBlocking(uint8_t b)
+{
+
   // By declaring these as local variables, the compiler will put them
   // in registers _before_ disabling interrupts and entering the
   // critical timing sections below, which makes it a lot easier to
@@ -488,7 +736,7 @@ size_t BeanSoftwareSerial::write(uint8_t b)
   return 1;
 }
 
-void BeanSoftwareSerial::flush()
+void BeanSoftwareSerialBase::flush()
 {
   if (!isListening())
     return;
@@ -499,7 +747,7 @@ void BeanSoftwareSerial::flush()
   SREG = oldSREG;
 }
 
-int BeanSoftwareSerial::peek()
+int BeanSoftwareSerialBase::peek()
 {
   if (!isListening())
     return -1;
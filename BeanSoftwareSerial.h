@@ -45,12 +45,31 @@ http://arduiniana.org.
 * Definitions
 ******************************************************************************/
 
-#define _SS_MAX_RX_BUFF 64 // RX buffer size
+#define _SS_MAX_RX_BUFF 64 // Default RX buffer size, must be a power of 2
+#define _SS_MAX_TX_BUFF 16 // Default TX buffer size, must be a power of 2
+#define _SS_MAX_LISTENERS 4 // Number of ports that may listen at the same time
+#define _SS_MIN_TX_TICKS 400 // CPU cycles per bit below which write() bit-bangs instead of using Timer2
+// Define _SS_TIMER_TX in the build flags (e.g. -D_SS_TIMER_TX) to clock
+// transmit out of Timer2 instead of bit-banging with interrupts off.
 #ifndef GCC_VERSION
 #define GCC_VERSION (__GNUC__ * 10000 + __GNUC_MINOR__ * 100 + __GNUC_PATCHLEVEL__)
 #endif
 
-class BeanSoftwareSerial : public Stream
+//  Software serial port that receives into a ring buffer owned by the
+//  instance.  Use BeanSoftwareSerialBuffered<size> below to set the size.
+//  Up to _SS_MAX_LISTENERS ports may listen and buffer at the same time,
+//  e.g. a GPS alongside the SIGFOX module.  The ports still share one CPU:
+//  a byte that starts while another port is receiving will be garbled.
+//  By default write() bit-bangs the byte with interrupts off.  With
+//  _SS_TIMER_TX, write() queues the byte and returns; the Timer2 compare
+//  interrupt clocks out one bit per interrupt.  Timer2 is then taken while
+//  transmitting: tone() won't link, and PWM on the Timer2 pins pauses until
+//  the queue drains and the Timer2 settings are restored.  One port
+//  transmits at a time, and the other listeners stop receiving meanwhile,
+//  since their receive interrupt would stretch the bit being sent.  While
+//  the port is listening, each byte is followed by one character of idle
+//  time so the echo can be received.
+class BeanSoftwareSerialBase : public Stream
 {
 private:
   // per object data
@@ -71,11 +90,32 @@ private:
   uint16_t _buffer_overflow:1;
   uint16_t _inverse_logic:1;
 
+  // RX ring buffer: storage is owned by BeanSoftwareSerialBuffered,
+  // size is a power of 2 so we wrap with the mask instead of %
+  char *_receive_buffer;
+  uint8_t _receive_mask;
+  volatile uint8_t _receive_buffer_tail;
+  volatile uint8_t _receive_buffer_head;
+  volatile uint16_t _overflow_count;  // Bytes dropped because the buffer was full
+  volatile uint8_t _high_water;  // Most bytes ever waiting in the buffer
+
+  // TX ring buffer, drained by the Timer2 compare interrupt
+  char *_transmit_buffer;
+  uint8_t _transmit_mask;
+  volatile uint8_t _transmit_buffer_tail;
+  volatile uint8_t _transmit_buffer_head;
+  uint8_t _tx_timer_clock;  // Timer2 clock select bits, 0 to bit-bang in write()
+  uint8_t _tx_timer_compare;  // Timer2 ticks per bit - 1
+
   // static data
-  static char _receive_buffer[_SS_MAX_RX_BUFF]; 
-  static volatile uint8_t _receive_buffer_tail;
-  static volatile uint8_t _receive_buffer_head;
-  static BeanSoftwareSerial *active_object;
+  static BeanSoftwareSerialBase *listeners[_SS_MAX_LISTENERS];
+  static BeanSoftwareSerialBase * volatile tx_object;  // Port being clocked out by Timer2
+  static volatile uint8_t tx_state;  // Next bit of the byte being sent
+  static uint8_t tx_byte;  // Remaining data bits of the byte being sent
+  static uint8_t tx_gap;  // Idle bits after each byte to receive the echo
+  static uint8_t tx_saved_tccr2a;  // Timer2 settings before transmit, restored after
+  static uint8_t tx_saved_tccr2b;
+  static uint8_t tx_saved_ocr2a;
 
   // private methods
   void recv() __attribute__((__always_inline__));
@@ -84,6 +124,10 @@ private:
   void setTX(uint8_t transmitPin);
   void setRX(uint8_t receivePin);
   void setRxIntMsk(bool enable) __attribute__((__always_inline__));
+  void startTransmit();
+  void stopTransmit();
+  void transmitBit() __attribute__((__always_inline__));
+  size_t writeBlocking(uint8_t byte);
 
   // Return num - sub, or 1 if the result would be < 1
   static uint16_t subtract_cap(uint16_t num, uint16_t sub);
@@ -91,17 +135,27 @@ private:
   // private static method for timing
   static inline void tunedDelay(uint16_t delay);
 
+protected:
+  // Buffer sizes must be powers of 2, up to 256
+  BeanSoftwareSerialBase(uint8_t receivePin, uint8_t transmitPin, bool inverse_logic,
+    char *buffer, uint16_t bufferSize, char *transmitBuffer, uint16_t transmitBufferSize);
+
 public:
   // public methods
-  BeanSoftwareSerial(uint8_t receivePin, uint8_t transmitPin, bool inverse_logic = false);
-  ~BeanSoftwareSerial();
+  ~BeanSoftwareSerialBase();
   void begin(long speed);
   bool listen();
   void end();
-  bool isListening() { return this == active_object; }
+  bool isListening();
   bool stopListening();
   bool overflow() { bool ret = _buffer_overflow; if (ret) _buffer_overflow = false; return ret; }
+  uint16_t overflowCount() { return _overflow_count; }  // Bytes dropped since resetStats()
+  uint8_t highWaterMark() { return _high_water; }  // Most bytes buffered since resetStats()
+  uint16_t bufferSize() { return (uint16_t) _receive_mask + 1; }
+  void resetStats();
   int peek();
+  void waitForTransmit();  // Wait until the queued bytes have been sent.  No-op without _SS_TIMER_TX.
+  int availableForWrite();
 
   virtual size_t write(uint8_t byte);
   virtual int read();
@@ -113,8 +167,32 @@ public:
 
   // public only for easy access by interrupt handlers
   static inline void handle_interrupt() __attribute__((__always_inline__));
+  static inline void handle_tx_interrupt() __attribute__((__always_inline__));
+};
+
+//  Software serial port with an RX buffer of RX_BUFFER bytes and a TX
+//  buffer of TX_BUFFER bytes, both powers of 2.
+template <uint16_t RX_BUFFER, uint16_t TX_BUFFER = _SS_MAX_TX_BUFF>
+class BeanSoftwareSerialBuffered : public BeanSoftwareSerialBase
+{
+  static_assert(RX_BUFFER >= 2 && RX_BUFFER <= 256 && (RX_BUFFER & (RX_BUFFER - 1)) == 0,
+    "RX buffer size must be a power of 2 from 2 to 256");
+  static_assert(TX_BUFFER >= 2 && TX_BUFFER <= 256 && (TX_BUFFER & (TX_BUFFER - 1)) == 0,
+    "TX buffer size must be a power of 2 from 2 to 256");
+
+public:
+  BeanSoftwareSerialBuffered(uint8_t receivePin, uint8_t transmitPin, bool inverse_logic = false) :
+    BeanSoftwareSerialBase(receivePin, transmitPin, inverse_logic, _buffer, RX_BUFFER,
+      _transmit, TX_BUFFER) {}
+
+private:
+  char _buffer[RX_BUFFER];
+  char _transmit[TX_BUFFER];
 };
 
+//  Drop-in replacement for SoftwareSerial with the default buffer size.
+typedef BeanSoftwareSerialBuffered<_SS_MAX_RX_BUFF> BeanSoftwareSerial;
+
 // Arduino 0012 workaround
 #undef int
 #undef char
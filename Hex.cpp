@@ -0,0 +1,150 @@
+//  Convert hex digit strings to bytes.  On x86 hosts the conversion is vectorised
+//  with SSE2 / AVX2 (chosen at runtime), elsewhere a scalar fallback is used.
+#include <string.h>
+#include "Hex.h"
+
+#if defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__))
+  #define HEX_SSE2
+  #include <emmintrin.h>
+  #if defined(__GNUC__) && !defined(__INTEL_COMPILER)
+    //  AVX2 code is compiled with a target attribute and used only if the CPU supports it.
+    #define HEX_AVX2
+    #include <immintrin.h>
+  #endif  //  __GNUC__
+#endif  //  __SSE2__
+
+uint8_t hexDigitToNibble(char ch) {
+  //  Convert 0..9, a..f, A..F to decimal.  Returns 0xff if ch is not a hex digit.
+  if (ch >= '0' && ch <= '9') return (uint8_t) (ch - '0');
+  if (ch >= 'a' && ch <= 'f') return (uint8_t) (ch - 'a' + 10);
+  if (ch >= 'A' && ch <= 'F') return (uint8_t) (ch - 'A' + 10);
+  return 0xff;
+}
+
+void bytesToHex(const uint8_t *bytes, size_t count, char *out) {
+  static const char nibbleToHex[] = "0123456789abcdef";
+  for (size_t i = 0; i < count; i++) {
+    *out++ = nibbleToHex[bytes[i] >> 4];
+    *out++ = nibbleToHex[bytes[i] & 0xf];
+  }
+}
+
+bool hexToBytesScalar(const char *hex, size_t hexLen, uint8_t *out) {
+  //  Convert 2 hex digits at a time to 1 byte.  Invalid digits are decoded as 0.
+  uint8_t invalid = 0;
+  for (size_t i = 0; i + 1 < hexLen; i = i + 2) {
+    uint8_t hi = hexDigitToNibble(hex[i]);
+    uint8_t lo = hexDigitToNibble(hex[i + 1]);
+    if (hi == 0xff) { invalid = 1; hi = 0; }
+    if (lo == 0xff) { invalid = 1; lo = 0; }
+    *out++ = (uint8_t) ((hi << 4) | lo);
+  }
+  return invalid == 0;
+}
+
+#ifdef HEX_SSE2
+static inline __m128i hexToNibbles16(__m128i ch, int &validMask) {
+  //  Convert 16 hex digits to 16 nibbles.  Each bit of validMask is set if that digit is valid.
+  //  SSE2 has only signed compares, so we shift each range to start at -128 before comparing.
+  const __m128i lower = _mm_or_si128(ch, _mm_set1_epi8(0x20));  //  'A'..'F' becomes 'a'..'f'.
+  const __m128i isDigit = _mm_cmplt_epi8(
+      _mm_add_epi8(ch, _mm_set1_epi8((char) (0x80 - '0'))), _mm_set1_epi8(-128 + 10));
+  const __m128i isLetter = _mm_cmplt_epi8(
+      _mm_add_epi8(lower, _mm_set1_epi8((char) (0x80 - 'a'))), _mm_set1_epi8(-128 + 6));
+  const __m128i digit = _mm_and_si128(isDigit, _mm_sub_epi8(ch, _mm_set1_epi8('0')));
+  const __m128i letter = _mm_and_si128(isLetter, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10)));
+  validMask = _mm_movemask_epi8(_mm_or_si128(isDigit, isLetter));
+  return _mm_or_si128(digit, letter);
+}
+
+static inline __m128i nibblesToBytes8(__m128i nibbles) {
+  //  Combine 16 nibbles into 8 bytes, returned in the low 64 bits.
+  //  Each 16-bit lane holds the high nibble in its low byte and the low nibble in its high byte.
+  const __m128i hi = _mm_slli_epi16(_mm_and_si128(nibbles, _mm_set1_epi16(0x00ff)), 4);
+  const __m128i lo = _mm_srli_epi16(nibbles, 8);
+  const __m128i bytes = _mm_or_si128(hi, lo);
+  return _mm_packus_epi16(bytes, bytes);
+}
+
+static bool hexToBytesSSE2(const char *hex, size_t hexLen, uint8_t *out) {
+  //  Convert 16 digits at a time, then 8 digits, then the rest with scalar code.
+  int invalid = 0, validMask = 0; size_t i = 0;
+  for (; i + 16 <= hexLen; i = i + 16) {
+    __m128i nibbles = hexToNibbles16(_mm_loadu_si128((const __m128i *) (hex + i)), validMask);
+    _mm_storel_epi64((__m128i *) (out + i / 2), nibblesToBytes8(nibbles));
+    invalid |= validMask ^ 0xffff;
+  }
+  if (i + 8 <= hexLen) {  //  E.g. the last 8 digits of a 24-digit payload.
+    __m128i nibbles = hexToNibbles16(_mm_loadl_epi64((const __m128i *) (hex + i)), validMask);
+    int bytes = _mm_cvtsi128_si32(nibblesToBytes8(nibbles));
+    memcpy(out + i / 2, &bytes, 4);
+    invalid |= (validMask & 0xff) ^ 0xff;
+    i = i + 8;
+  }
+  if (!hexToBytesScalar(hex + i, hexLen - i, out + i / 2)) invalid = 1;
+  return invalid == 0;
+}
+#endif  //  HEX_SSE2
+
+#ifdef HEX_AVX2
+__attribute__((target("avx2")))
+static bool hexToBytesAVX2(const char *hex, size_t hexLen, uint8_t *out) {
+  //  Convert 32 digits at a time, then hand over the rest to the SSE2 code.
+  //  Same steps as hexToNibbles16 and nibblesToBytes8 but with 256-bit registers.
+  int invalid = 0; size_t i = 0;
+  for (; i + 32 <= hexLen; i = i + 32) {
+    const __m256i ch = _mm256_loadu_si256((const __m256i *) (hex + i));
+    const __m256i lower = _mm256_or_si256(ch, _mm256_set1_epi8(0x20));
+    const __m256i isDigit = _mm256_cmpgt_epi8(_mm256_set1_epi8(-128 + 10),
+        _mm256_add_epi8(ch, _mm256_set1_epi8((char) (0x80 - '0'))));
+    const __m256i isLetter = _mm256_cmpgt_epi8(_mm256_set1_epi8(-128 + 6),
+        _mm256_add_epi8(lower, _mm256_set1_epi8((char) (0x80 - 'a'))));
+    const __m256i nibbles = _mm256_or_si256(
+        _mm256_and_si256(isDigit, _mm256_sub_epi8(ch, _mm256_set1_epi8('0'))),
+        _mm256_and_si256(isLetter, _mm256_sub_epi8(lower, _mm256_set1_epi8('a' - 10))));
+    invalid |= ~_mm256_movemask_epi8(_mm256_or_si256(isDigit, isLetter));
+    const __m256i bytes = _mm256_or_si256(
+        _mm256_slli_epi16(_mm256_and_si256(nibbles, _mm256_set1_epi16(0x00ff)), 4),
+        _mm256_srli_epi16(nibbles, 8));
+    //  Pack works within each 128-bit lane, so gather the two 64-bit results together.
+    const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(bytes, bytes), 0x08);
+    _mm_storeu_si128((__m128i *) (out + i / 2), _mm256_castsi256_si128(packed));
+  }
+  if (!hexToBytesSSE2(hex + i, hexLen - i, out + i / 2)) invalid = 1;
+  return invalid == 0;
+}
+
+static bool cpuHasAVX2() {
+  //  Check once whether the CPU supports AVX2.
+  static const bool hasAVX2 = __builtin_cpu_supports("avx2");
+  return hasAVX2;
+}
+#endif  //  HEX_AVX2
+
+bool hexToBytes(const char *hex, size_t hexLen, uint8_t *out) {
+  //  Convert hexLen hex digits into hexLen / 2 bytes with the fastest code available.
+#ifdef HEX_AVX2
+  if (hexLen >= 32 && cpuHasAVX2()) return hexToBytesAVX2(hex, hexLen, out);
+#endif  //  HEX_AVX2
+#ifdef HEX_SSE2
+  return hexToBytesSSE2(hex, hexLen, out);
+#else  //  HEX_SSE2
+  return hexToBytesScalar(hex, hexLen, out);
+#endif  //  HEX_SSE2
+}
+
+size_t hexToBytesBulk(const char *hex, size_t hexLen, size_t count,
+                      uint8_t *out, uint8_t *invalid) {
+  //  Convert count hex strings of hexLen digits each.  For even lengths the strings
+  //  form one long run of digits, so we convert and validate the whole run in one pass.
+  //  Only if the run contains an invalid digit do we check the strings one by one.
+  if (invalid) memset(invalid, 0, count);
+  if (hexLen % 2 == 0 && hexToBytes(hex, hexLen * count, out)) return 0;
+  size_t invalidCount = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (hexToBytes(hex + i * hexLen, hexLen, out + i * (hexLen / 2))) continue;
+    if (invalid) invalid[i] = 1;
+    invalidCount++;
+  }
+  return invalidCount;
+}
@@ -0,0 +1,31 @@
+//  Convert hex digit strings (e.g. SIGFOX payloads like "b0513801a421f0019405a500")
+//  to bytes.  On x86 hosts the conversion is vectorised with SSE2 / AVX2,
+//  elsewhere (e.g. Arduino) a scalar fallback is used.
+#ifndef UNABIZ_ARDUINO_HEX_H
+#define UNABIZ_ARDUINO_HEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+//  Convert 0..9, a..f, A..F to decimal.  Returns 0xff if ch is not a hex digit.
+uint8_t hexDigitToNibble(char ch);
+
+//  Convert hexLen hex digits (2 digits per byte, first digit is the high nibble)
+//  into hexLen / 2 bytes in out.  Returns true if all digits were valid.
+//  Invalid digits are decoded as 0.
+bool hexToBytes(const char *hex, size_t hexLen, uint8_t *out);
+
+//  Convert count bytes into 2 * count lowercase hex digits in out, not terminated.
+void bytesToHex(const uint8_t *bytes, size_t count, char *out);
+
+//  Same as hexToBytes but always uses the scalar code.  Used for benchmarking.
+bool hexToBytesScalar(const char *hex, size_t hexLen, uint8_t *out);
+
+//  Convert count hex strings of hexLen digits each, stored back to back in hex
+//  (e.g. a log of 24-digit payloads), into count * hexLen / 2 bytes in out.
+//  If invalid is not null, invalid[i] is set to 1 if string i contains an
+//  invalid digit, else 0.  Returns the number of invalid strings.
+size_t hexToBytesBulk(const char *hex, size_t hexLen, size_t count,
+                      uint8_t *out, uint8_t *invalid);
+
+#endif  //  UNABIZ_ARDUINO_HEX_H
@@ -0,0 +1,76 @@
+//  Latency histograms for the commands sent to the SIGFOX module.
+#ifdef ARDUINO
+  #if (ARDUINO >= 100)
+    #include <Arduino.h>
+  #else  //  ARDUINO >= 100
+    #include <WProgram.h>
+  #endif  //  ARDUINO  >= 100
+#endif  //  ARDUINO
+
+#include "Histogram.h"
+
+static const char nibbleToHex[] = "0123456789abcdef";
+
+static uint8_t bitLength(unsigned long value) {
+  //  Return the number of bits needed for the value, 0 for 0.
+  uint8_t bits = 0;
+  while (value > 0) { bits++; value = value >> 1; }
+  return bits;
+}
+
+void LatencyHistogram::clear() {
+  for (uint8_t t = 0; t < COMMAND_TYPES; t++) {
+    for (uint8_t b = 0; b < HISTOGRAM_BUCKETS; b++) buckets[t][b] = 0;
+    timeouts[t] = 0;
+  }
+}
+
+void LatencyHistogram::add(uint8_t type, unsigned long ms) {
+  if (type >= COMMAND_TYPES) type = COMMAND_OTHER;
+  uint8_t bucket = bitLength(ms);
+  if (bucket >= HISTOGRAM_BUCKETS) bucket = HISTOGRAM_BUCKETS - 1;
+  if (buckets[type][bucket] < 255) buckets[type][bucket]++;
+}
+
+void LatencyHistogram::addTimeout(uint8_t type) {
+  if (type >= COMMAND_TYPES) type = COMMAND_OTHER;
+  if (timeouts[type] < 255) timeouts[type]++;
+}
+
+uint16_t LatencyHistogram::getCount(uint8_t type) const {
+  uint16_t count = 0;
+  for (uint8_t b = 0; b < HISTOGRAM_BUCKETS; b++) count = count + buckets[type][b];
+  return count;
+}
+
+void LatencyHistogram::dump(Print &port) const {
+  //  Print "type: count=n timeouts=n <1ms:n <2ms:n <4ms:n ..." for each type used.
+  static const char *const names[COMMAND_TYPES] = { "send", "presend", "id", "sensor", "switch", "other" };
+  for (uint8_t t = 0; t < COMMAND_TYPES; t++) {
+    if (getCount(t) == 0 && timeouts[t] == 0) continue;
+    port.print(names[t]); port.print(F(": count="));  port.print(getCount(t));
+    port.print(F(" timeouts="));  port.print(timeouts[t]);
+    for (uint8_t b = 0; b < HISTOGRAM_BUCKETS; b++) {
+      if (buckets[t][b] == 0) continue;
+      port.print(F(" <"));  port.print(1UL << b);  port.print(F("ms:"));  port.print(buckets[t][b]);
+    }
+    port.println();
+  }
+}
+
+String LatencyHistogram::pack(uint8_t type) const {
+  uint8_t bytes[12];
+  const uint16_t count = getCount(type);
+  bytes[0] = type;
+  bytes[1] = timeouts[type];
+  bytes[2] = (uint8_t) (count >> 8);
+  bytes[3] = (uint8_t) count;
+  for (uint8_t b = 0; b < HISTOGRAM_BUCKETS; b = b + 2)
+    bytes[4 + b / 2] = (bitLength(buckets[type][b]) << 4) | bitLength(buckets[type][b + 1]);
+  String result;
+  for (uint8_t i = 0; i < 12; i++) {
+    result.concat(nibbleToHex[bytes[i] >> 4]);
+    result.concat(nibbleToHex[bytes[i] & 0xf]);
+  }
+  return result;
+}
@@ -0,0 +1,50 @@
+//  Latency histograms for the commands sent to the SIGFOX module, one per command
+//  type, with log2 buckets in milliseconds.  Updated by the drivers for every
+//  command with a few integer operations and no allocation, so they can stay on
+//  in production.  Dump them to Serial, or pack one into an uplink payload to
+//  spot degrading modules before they fail.
+#ifndef UNABIZ_ARDUINO_HISTOGRAM_H
+#define UNABIZ_ARDUINO_HISTOGRAM_H
+
+#ifdef ARDUINO
+  #if (ARDUINO >= 100)
+    #include <Arduino.h>
+  #else  //  ARDUINO >= 100
+    #include <WProgram.h>
+  #endif  //  ARDUINO  >= 100
+#endif  //  ARDUINO
+
+//  Command types.  Wisol and Radiocrafts commands map to the nearest type.
+enum CommandType {
+  COMMAND_SEND = 0,  //  Wisol AT$SF.
+  COMMAND_PRESEND = 1,  //  Wisol AT$GI?, AT$RC, ATS302.
+  COMMAND_ID = 2,  //  Wisol AT$I, Radiocrafts '9'.
+  COMMAND_SENSOR = 3,  //  Wisol AT$T?, AT$V?, Radiocrafts 'U', 'V'.
+  COMMAND_SWITCH = 4,  //  Radiocrafts enter / exit Command Mode and Config Mode.
+  COMMAND_OTHER = 5,
+  COMMAND_TYPES = 6
+};
+
+//  Bucket 0 counts latencies of 0 ms, bucket b counts 2^(b-1) to 2^b - 1 ms,
+//  the last bucket counts 16384 ms and above (e.g. downlinks).
+const uint8_t HISTOGRAM_BUCKETS = 16;
+
+class LatencyHistogram
+{
+public:
+  LatencyHistogram() { clear(); }
+  void clear();
+  void add(uint8_t type, unsigned long ms);  //  Count a response after ms milliseconds.
+  void addTimeout(uint8_t type);  //  Count a command that got no response.
+  uint16_t getCount(uint8_t type) const;  //  Number of responses of this type.
+  void dump(Print &port) const;  //  Print the non-empty histograms, one line per type.
+  //  Pack the histogram for the type into 24 hex digits (12 bytes) for sendMessage():
+  //  type, timeouts, count (2 bytes, MSB first), then 16 buckets of 4 bits each,
+  //  holding log2(count + 1) so that the shape survives in 8 bytes.
+  String pack(uint8_t type) const;
+
+  uint8_t buckets[COMMAND_TYPES][HISTOGRAM_BUCKETS];  //  Saturate at 255.
+  uint8_t timeouts[COMMAND_TYPES];  //  Saturate at 255.
+};
+
+#endif  //  UNABIZ_ARDUINO_HISTOGRAM_H
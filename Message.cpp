@@ -9,6 +9,7 @@
 
 #include "SIGFOX.h"
 #include "Message.h"
+#include "Hex.h"
 
 //  Encode each letter (lowercase only) in 5 bits:
 //  0 = End of name/value or can't be encoded.
@@ -169,31 +170,17 @@ String Message::getEncodedMessage() {
   return encodedMessage;
 }
 
-static uint8_t hexDigitToDecimal(char ch) {
-  //  Convert 0..9, a..f, A..F to decimal.
-  if (ch >= '0' && ch <= '9') return (uint8_t) ch - '0';
-  if (ch >= 'a' && ch <= 'z') return (uint8_t) ch - 'a' + 10;
-  if (ch >= 'A' && ch <= 'Z') return (uint8_t) ch - 'A' + 10;
-  return 0;
-}
-
 String Message::decodeMessage(String msg) {
   //  Decode the encoded message.
   //  2 bytes name, 2 bytes float * 10, 2 bytes name, 2 bytes float * 10, ...
   String result = "{";
   for (int i = 0; i < msg.length(); i = i + 8) {
-    String name = msg.substring(i, i + 4);
-    String val = msg.substring(i + 4, i + 8);
-    unsigned long name2 =
-      (hexDigitToDecimal(name.charAt(2)) << 12) +
-      (hexDigitToDecimal(name.charAt(3)) << 8) +
-      (hexDigitToDecimal(name.charAt(0)) << 4) +
-      hexDigitToDecimal(name.charAt(1));
-    unsigned long val2 =
-      (hexDigitToDecimal(val.charAt(2)) << 12) +
-      (hexDigitToDecimal(val.charAt(3)) << 8) +
-      (hexDigitToDecimal(val.charAt(0)) << 4) +
-      hexDigitToDecimal(val.charAt(1));
+    //  Convert the 8 hex digits of the field to 4 bytes.  Missing digits are decoded as 0.
+    uint8_t field[] = {0, 0, 0, 0};
+    const int len = (msg.length() - i < 8) ? msg.length() - i : 8;
+    hexToBytes(msg.c_str() + i, len, field);
+    unsigned long name2 = ((unsigned long) field[1] << 8) + field[0];
+    unsigned long val2 = ((unsigned long) field[3] << 8) + field[2];
     if (i > 0) result.concat(',');
     result.concat('"');
     //  Decode name.
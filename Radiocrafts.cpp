@@ -8,6 +8,7 @@
 #endif  //  ARDUINO
 
 #include "SIGFOX.h"
+#include "Hex.h"
 
 //  Use a macro for logging because Flash strings not supported with String class in Bean+
 #define log1(x) { echoPort->println(x); }
@@ -15,11 +16,20 @@
 // #define log3(x, y, z) { echoPort->print(x); echoPort->print(y); echoPort->println(z); }
 #define log4(x, y, z, a) { echoPort->print(x); echoPort->print(y); echoPort->print(z); echoPort->println(a); }
 
-#define MODEM_BITS_PER_SECOND 19200
 #define END_OF_RESPONSE '>'  //  Character '>' marks the end of response.
 #define CMD_READ_MEMORY 'Y'  //  'Y' to read memory.
+#define CMD_READ_ID '9'  //  '9' to get the SIGFOX ID and PAC.
+#define CMD_READ_TEMPERATURE 'U'  //  'U' to get the module temperature.
+#define CMD_READ_VOLTAGE 'V'  //  'V' to get the supply voltage.
+#define CMD_ENTER_COMMAND 0x00  //  0x00 to enter command mode from send mode.
+#define CMD_EXIT_COMMAND 'X'  //  'X' to exit command mode to send mode.
 #define CMD_ENTER_CONFIG 'M'  //  'M' to enter config mode.
-#define CMD_EXIT_CONFIG (char) 0xff  //  Exit config mode.
+#define CMD_EXIT_CONFIG 0xff  //  Exit config mode.
+#define CONFIG_UART_BAUD 0x30  //  Address of UART_BAUD in config memory.
+
+//  UART rates for UART_BAUD values 1 to 10, in hundreds of bps.
+static const uint16_t uartRates[] PROGMEM = { 24, 48, 96, 144, 192, 288, 384, 576, 768, 1152 };
+static const uint8_t uartRateCount = sizeof(uartRates) / sizeof(uartRates[0]);
 
 static NullPort nullPort;
 
@@ -37,17 +47,27 @@ Radiocrafts::Radiocrafts(Country country0, bool useEmulator0, const String devic
     Radiocrafts(country0, useEmulator0, device0, echo, RADIOCRAFTS_RX, RADIOCRAFTS_TX) {}  //  Forward to constructor below.
 
 Radiocrafts::Radiocrafts(Country country0, bool useEmulator0, const String device0, bool echo,
-                         uint8_t rx, uint8_t tx) {
-  //  Init the module with the specified transmit and receive pins.
+                         uint8_t rx, uint8_t tx):
+    //  Init the module with the specified transmit and receive pins.
+    //  Bean+ firmware 0.6.1 can't receive serial data properly. We provide
+    //  an alternative class BeanSoftwareSerial to work around this.
+    //  For Bean, SoftwareSerial is a #define alias for BeanSoftwareSerial.
+    Radiocrafts(country0, useEmulator0, device0, echo, SIGFOX_SERIAL_OPEN(rx, tx)) {}
+
+Radiocrafts::Radiocrafts(Country country0, bool useEmulator0, const String device0, bool echo,
+                         SIGFOX_SERIAL_PORT *port) {
+  //  Init the module with the specified serial port.
   //  Default to no echo.
   mode = SEND_MODE;
+  modeResyncs = 0;
+  bitsPerSecond = RADIOCRAFTS_BITS_PER_SECOND;
+  responseLength = 0;
   country = country0;
   useEmulator = useEmulator0;
   device = device0;
-  //  Bean+ firmware 0.6.1 can't receive serial data properly. We provide
-  //  an alternative class BeanSoftwareSerial to work around this.
-  //  For Bean, SoftwareSerial is a #define alias for BeanSoftwareSerial.
-  serialPort = new SoftwareSerial(rx, tx);
+  serialPort = port;
+  captureHook = 0;
+  captureContext = 0;
   if (echo) echoPort = &Serial;
   else echoPort = &nullPort;
   lastEchoPort = &Serial;
@@ -65,6 +85,14 @@ bool Radiocrafts::begin() {
     delay(2000);
 #endif // BEAN_BEAN_BEAN_H
     String result;
+    //  Find the UART rate of the module.  The probe enters Command Mode, which the
+    //  commands below need anyway.  If not found, the commands below resync.
+    if (!detectBitsPerSecond()) log1(F(" - Radiocrafts.begin: Warning: UART rate not detected"));
+#ifdef SIGFOX_SERIAL_FAST_BITS_PER_SECOND
+    //  Opt-in, see SerialPort.h: a hardware UART can take a faster link.  The
+    //  module keeps the rate in its nonvolatile config.
+    if (bitsPerSecond != SIGFOX_SERIAL_FAST_BITS_PER_SECOND) setBitsPerSecond(SIGFOX_SERIAL_FAST_BITS_PER_SECOND);
+#endif  //  SIGFOX_SERIAL_FAST_BITS_PER_SECOND
     if (useEmulator) {
       //  Emulation mode.
       if (!enableEmulator(result)) continue;
@@ -81,8 +109,8 @@ bool Radiocrafts::begin() {
     //  Read SIGFOX ID and PAC from module.
     log1(F(" - Getting SIGFOX ID..."));  String id, pac;
     if (!getID(id, pac)) continue;
-    echoPort->print(F(" - SIGFOX ID = "));  Serial.println(id);
-    echoPort->print(F(" - PAC = "));  Serial.println(pac);
+    echoPort->print(F(" - SIGFOX ID = "));  echoPort->println(id);
+    echoPort->print(F(" - PAC = "));  echoPort->println(pac);
 
     //  Set the frequency of SIGFOX module.
     log2(F(" - Setting frequency for country "), (int) country);
@@ -109,106 +137,153 @@ bool Radiocrafts::sendMessage(const String &payload) {
   //  We convert to binary and send to SIGFOX.  Return true if successful.
   //  We represent the payload as hex instead of binary because 0x00 is a
   //  valid payload and this causes string truncation in C libraries.
-  //  Assumes we are in Send Mode.
   log2(F(" - Radiocrafts.sendMessage: "), device + ',' + payload);
+  uint8_t bytes[MAX_BYTES_PER_MESSAGE];
+  const unsigned length = payload.length() / 2;
+  if (payload.length() % 2 != 0 || length > MAX_BYTES_PER_MESSAGE
+      || !hexToBytes(payload.c_str(), length * 2, bytes)) {
+    log2(F(" - Radiocrafts.sendMessage: Error: Invalid payload "), payload);
+    return false;
+  }
+  return sendBytes(bytes, length);
+}
+
+bool Radiocrafts::sendBytes(const uint8_t *payload, uint8_t length) {
+  //  Send the binary payload, up to 12 bytes, to SIGFOX without converting to hex.
+  //  Switches to Send Mode if needed.  Return true if successful.
+  if (length > MAX_BYTES_PER_MESSAGE) {
+    log2(F(" - Radiocrafts.sendBytes: Error: Too many bytes "), length);
+    return false;
+  }
+  //  A length byte of 0x00 is CMD_ENTER_COMMAND, which would switch the module to Command Mode.
+  if (length == 0) {
+    log1(F(" - Radiocrafts.sendBytes: Error: Empty payload"));
+    return false;
+  }
   if (!isReady()) return false;  //  Prevent user from sending too many messages without sufficient delay.
+  if (!switchMode(SEND_MODE)) return false;
 
-  //  Decode and send the data.
   //  First byte is payload length, followed by rest of payload.
-  String message = toHex((char) (payload.length() / 2)) + payload, data;
+  uint8_t message[MAX_BYTES_PER_MESSAGE + 1];
+  message[0] = length;
+  memcpy(message + 1, payload, length);
   uint8_t markers = 0;
-  if (sendBuffer(message, COMMAND_TIMEOUT, 0, data, markers)) {  //  No markers expected.
-    log1(data);
-    lastSend = millis();
-    return true;
+  if (!sendBuffer(message, length + 1, COMMAND_TIMEOUT, 0, markers)) return false;  //  No markers expected.
+  lastSend = millis();
+  return true;
+}
+
+bool Radiocrafts::sendCommand(const uint8_t *cmd, uint8_t length,
+                              uint8_t expectedMarkerCount, uint8_t &actualMarkerCount) {
+  //  Send a Radiocrafts command in Command Mode.  The response is in response[].
+  //  Switches to Command Mode if needed and stays there, so that commands sent
+  //  back to back skip the mode switches.  sendMessage() returns to Send Mode.
+  //  Return true if successful.
+  for (uint8_t retry = 0; retry < RADIOCRAFTS_MODE_RETRIES; retry++) {
+    if (!switchMode(COMMAND_MODE)) return false;
+    if (sendBuffer(cmd, length, COMMAND_TIMEOUT, expectedMarkerCount, actualMarkerCount)) return true;
+    //  No response: the module may not be in Command Mode after all.  Resync and retry.
+    mode = UNKNOWN_MODE;
   }
   return false;
 }
 
-bool Radiocrafts::sendCommand(const String &cmd, uint8_t expectedMarkerCount,
-                              String &result, uint8_t &actualMarkerCount) {
-  //  Send a Radiocrafts command in Command Mode.
-  //  Switches to Command Mode and returns to Send Mode after sending.
-  //  Device must be already in Send Mode.
-  //  cmd contains a string of hex digits, up to 24 digits / 12 bytes.
-  //  We convert to binary and send to SIGFOX.  Return true if successful.
-  String data;
-  //  Enter command mode.
-  if (!enterCommandMode()) return false;
-  bool status = sendBuffer(cmd, COMMAND_TIMEOUT, expectedMarkerCount,
-    data, actualMarkerCount);
-  if (status) result = data;
-  //  Always exit command mode so that the device is normally in send mode.
-  if (!exitCommandMode()) return false;
-  return status;
-}
-
-bool Radiocrafts::sendConfigCommand(const String &cmd, String &result) {
-  //  Send a Radiocrafts config command in Config Mode.
-  //  Switches to Config Mode and returns to Send Mode after sending.
-  //  Device must be already in Send Mode.
-  //  cmd contains a string of hex digits, up to 24 digits / 12 bytes.
-  //  We convert to binary and send to SIGFOX.  Return true if successful.
-  String data;
-  //  Enter config mode.
-  if (!enterConfigMode()) return false;
+bool Radiocrafts::writeConfig(uint8_t address, uint8_t value) {
+  //  Write the config value at the address in Config Mode, without checking it.
+  //  The module does not respond to config writes.
+  if (!switchMode(CONFIG_MODE)) return false;
+  const uint8_t cmd[] = { address, value };
   uint8_t actualMarkerCount = 0;
-  bool status = sendBuffer(cmd, COMMAND_TIMEOUT, 0,
-                           data, actualMarkerCount);
-  if (status) result = data;
-  //  Always exit config mode so that the device is normally in send mode.
-  if (!exitConfigMode()) return false;
-  return status;
-}
-
-//  Remember where in response the '>' markers were seen.
-const uint8_t markerPosMax = 5;
-static uint8_t markerPos[markerPosMax];
-
-bool Radiocrafts::sendBuffer(const String &buffer, const int timeout,
-                             uint8_t expectedMarkerCount, String &response,
-                             uint8_t &actualMarkerCount) {
-  //  buffer contains a string of hex digits, up to 24 digits / 12 bytes.
-  //  We convert to binary and send to SIGFOX.  Return true if successful.
-  //  We represent the payload as hex instead of binary because 0x00 is a
-  //  valid payload and this causes string truncation in C libraries.
+  return sendBuffer(cmd, sizeof(cmd), COMMAND_TIMEOUT, 0, actualMarkerCount);
+}
+
+bool Radiocrafts::sendConfigCommand(uint8_t address, uint8_t value, String &result) {
+  //  Write the config value at the address and read it back in Command Mode.
+  //  The write gets no response, so if the module was not really in Config Mode
+  //  (e.g. it was reset) the bytes are lost silently.  The read back catches that.
+  //  Return true if the module now holds the value.
+  if (!writeConfig(address, value)) return false;
+  if (useEmulator) return true;  //  Nothing is sent to the module.
+  const uint8_t cmd[] = { CMD_READ_MEMORY, address };
+  uint8_t markers = 0;
+  if (!sendCommand(cmd, sizeof(cmd), 2, markers)) return false;  //  1 marker for command, 1 for response.
+  result = responseToHex();
+  if (responseLength != 1 || response[0] != value) {
+    log4(F(" - Radiocrafts.sendConfigCommand: Error: Config not written at 0x"), toHex((char) address),
+         F(", read back "), result);
+    mode = UNKNOWN_MODE;
+    return false;
+  }
+  return true;
+}
+
+String Radiocrafts::responseToHex() {
+  //  Return the response as a string of hex digits.
+  char hex[RADIOCRAFTS_BUFFER_MAX * 2 + 1];
+  bytesToHex(response, responseLength, hex);
+  hex[responseLength * 2] = 0;
+  return String(hex);
+}
+
+uint8_t Radiocrafts::commandType(uint8_t cmd) {
+  //  Return the latency histogram type for the command byte, which depends on
+  //  the current mode.
+  switch (mode) {
+    case SEND_MODE: return cmd == 0x00 ? COMMAND_SWITCH : COMMAND_SEND;  //  0x00 enters Command Mode.
+    case CONFIG_MODE: return cmd == CMD_EXIT_CONFIG ? COMMAND_SWITCH : COMMAND_OTHER;
+    default: break;
+  }
+  switch (cmd) {
+    case CMD_EXIT_COMMAND: case CMD_ENTER_CONFIG: return COMMAND_SWITCH;
+    case CMD_READ_ID: return COMMAND_ID;
+    case CMD_READ_TEMPERATURE: case CMD_READ_VOLTAGE: return COMMAND_SENSOR;
+    default: return COMMAND_OTHER;
+  }
+}
+
+bool Radiocrafts::sendBuffer(const uint8_t *buffer, uint8_t length, const int timeout,
+                             uint8_t expectedMarkerCount, uint8_t &actualMarkerCount) {
+  //  Send the bytes in buffer to the module and receive the response bytes into
+  //  response[], without converting to or from hex.  Return true if successful.
   //  expectedMarkerCount is the number of end-of-command markers '>' we
   //  expect to see.  actualMarkerCount contains the actual number seen.
-  log2(F(" - Radiocrafts.sendBuffer: "), buffer);
-  response = "";
+  responseLength = 0;
   if (useEmulator) return true;
 
   actualMarkerCount = 0;
-  //  Start serial interface.
-  serialPort->begin(MODEM_BITS_PER_SECOND);
+  //  Start serial interface.  If the port can't run at this rate, don't send
+  //  anything: the module might answer at another rate and mislead detection.
+  if (!serialBegin(serialPort, bitsPerSecond)) {
+    log2(F(" - Radiocrafts.sendBuffer: Error: Port can't open at "), bitsPerSecond);
+    return false;
+  }
 #ifdef BEAN_BEAN_BEAN_H
   Bean.sleep(200);
 #else  // BEAN_BEAN_BEAN_H
   delay(200);
 #endif // BEAN_BEAN_BEAN_H
-  serialPort->flush();
-  serialPort->listen();
+  serialListen(serialPort);
 
-  //  Send the buffer: need to write/read char by char because of echo.
-  const char *rawBuffer = buffer.c_str();
   //  Send buffer and read response.  Loop until timeout or we see the end of response marker.
-  unsigned long startTime = millis(); int i = 0;
-  //  Previous code for verifying that data was sent correctly.
-  //static String echoSend = "", echoReceive = "";
+  unsigned long startTime = millis(), responseTime = 0; uint8_t i = 0;
   for (;;) {
     //  If there is data to send, send it.
-    if (i < buffer.length()) {
-      //  Convert 2 hex digits to 1 char and send.
-      uint8_t txChar = hexDigitToDecimal(rawBuffer[i]) * 16 +
-                       hexDigitToDecimal(rawBuffer[i + 1]);
-      //echoSend.concat(toHex((char) txChar) + ' ');
+    if (i < length) {
+      //  Need to write/read char by char because of echo.
+      const uint8_t txChar = buffer[i];
       serialPort->write(txChar);
+      if (captureHook) captureHook(captureContext, true, txChar);
+      //  Need to wait a while because SoftwareSerial has no FIFO and may overflow.
+      //  A queued port (SIGFOX_SERIAL_QUEUED) has no pacing: the bytes are queued
+      //  and sent while we wait for the response.
+      if (SIGFOX_SERIAL_PACING(10) > 0) {
 #ifdef BEAN_BEAN_BEAN_H
-      Bean.sleep(10);
+        Bean.sleep(SIGFOX_SERIAL_PACING(10));
 #else  // BEAN_BEAN_BEAN_H
-      delay(10);  //  Need to wait a while because SoftwareSerial has no FIFO and may overflow.
+        delay(SIGFOX_SERIAL_PACING(10));
 #endif // BEAN_BEAN_BEAN_H
-      i = i + 2;
+      }
+      i = i + 1;
       startTime = millis();  //  Start the timer only when all data has been sent.
     }
 
@@ -216,41 +291,44 @@ bool Radiocrafts::sendBuffer(const String &buffer, const int timeout,
     const unsigned long currentTime = millis();
     if (currentTime - startTime > timeout) break;
 
-    //  If data is available to receive, receive it.
+    //  If data is available to receive, receive it.  Once all data has been sent,
+    //  wait for the response without spinning if the port supports it.
+    if (i >= length && !waitForSerial(serialPort, timeout - (currentTime - startTime))) continue;
     if (serialPort->available() > 0) {
       int rxChar = serialPort->read();
-      //  echoReceive.concat(toHex((char) rxChar) + ' ');
       if (rxChar == -1) continue;
+      if (captureHook) captureHook(captureContext, false, (uint8_t) rxChar);
       if (rxChar == END_OF_RESPONSE) {
+        if (actualMarkerCount == 0) responseTime = millis() - startTime;
         if (actualMarkerCount < markerPosMax)
-          markerPos[actualMarkerCount] = response.length();  //  Remember the marker pos.
+          markerPos[actualMarkerCount] = responseLength;  //  Remember the marker pos.
         actualMarkerCount++;  //  Count the number of end markers.
         if (actualMarkerCount >= expectedMarkerCount) break;  //  Seen all markers already.
-      } else {
-        response.concat(toHex((char) rxChar));
+      } else if (responseLength < RADIOCRAFTS_BUFFER_MAX) {
+        response[responseLength++] = (uint8_t) rxChar;
       }
     }
 
     //  TODO: Check for downlink response.
 
   }
-  serialPort->end();
+  serialEnd(serialPort);
   //  Log the actual bytes sent and received.
-  //log2(F(">> "), echoSend);
-  //  if (echoReceive.length() > 0) { log2(F("<< "), echoReceive); }
-  logBuffer(F(">> "), rawBuffer, 0, 0);
-  logBuffer(F("<< "), response.c_str(), markerPos, actualMarkerCount);
+  logBuffer(F(">> "), buffer, length, 0, 0);
+  logBuffer(F("<< "), response, responseLength, markerPos, actualMarkerCount);
+  //  Count the time to the first marker in the latency histogram, or the timeout.
+  if (actualMarkerCount > 0) latency.add(commandType(buffer[0]), responseTime);
+  else if (expectedMarkerCount > 0) latency.addTimeout(commandType(buffer[0]));
 
   //  If we did not see the terminating '>', something is wrong.
   if (actualMarkerCount < expectedMarkerCount) {
-    if (response.length() == 0) {
+    if (responseLength == 0) {
       log1(F(" - Radiocrafts.sendBuffer: Error: No response"));  //  Response timeout.
     } else {
-      log2(F(" - Radiocrafts.sendBuffer: Error: Unknown response: "), response);
+      log1(F(" - Radiocrafts.sendBuffer: Error: Unknown response"));
     }
     return false;
   }
-  log2(F(" - Radiocrafts.sendBuffer: response: "), response);
   //  TODO: Parse the downlink response.
   return true;
 }
@@ -303,92 +381,161 @@ bool Radiocrafts::isReady()
   return true;
 }
 
-static String data;  //  Used by all functions except enter/exit command/config mode.
-static String modeData;  //  Used by enter/exit command/config mode only.
 
 bool Radiocrafts::enterCommandMode() {
-  //  Enter Command Mode for sending module commands, not data.  Assumes we are in Send Mode.
-  log1(F(" - Entering command mode..."));
-  //  Confirm we are in SEND_MODE
-  if (mode != SEND_MODE) {
-    log1(F(" - Warning: Radiocrafts.enterCommandMode did not detect expected Send Mode, may be in incorrect mode"));
-  }
-  uint8_t markers = 0;
-  if (!sendBuffer("00", COMMAND_TIMEOUT, 1, modeData, markers)) return false;
-  //  Confirm response = '>'
-  if (modeData != String("") || markers != 1) {
-    log1(F(" - Warning: Radiocrafts.enterCommandMode did not receive expected '>', may be in incorrect mode"));
-  }
-  mode = COMMAND_MODE;
+  //  Enter Command Mode for sending module commands, not data.
+  if (!switchMode(COMMAND_MODE)) return false;
   log1(F(" - Radiocrafts.enterCommandMode: OK "));
   return true;
 }
 
 bool Radiocrafts::exitCommandMode() {
-  //  Exit Command Mode and return to Send Mode so we can send data.  Assumes we are in Command Mode.
-  log1(F(" - Exiting command mode..."));
-  //  Confirm we are in COMMAND_MODE.
-  if (mode != COMMAND_MODE) {
-    log1(F(" - Warning: Radiocrafts.exitCommandMode did not detect expected Command Mode, may be in incorrect mode"));
-  }
-  for (;;) {
-    //  Keep sending the exit command until we are really sure.  Sometimes we might out of sync.
-    uint8_t markers = 0;
-    if (!sendBuffer(toHex('X'), COMMAND_TIMEOUT, 0, modeData, markers)) return false;
-    if (modeData == String("") && markers == 0) break;
-    log1(F(" - Warning: Radiocrafts.exitCommandMode resending exit command, may be in incorrect mode"));
-  }
-  mode = SEND_MODE;
+  //  Exit Command Mode and return to Send Mode so we can send data.
+  if (!switchMode(SEND_MODE)) return false;
   log1(F(" - Radiocrafts.exitCommandMode: OK "));
   return true;
 }
 
-bool Radiocrafts::enterConfigMode() {
-  //  Enter Config Mode for setting config.  Assumes we are in Send Mode.
-  //  Device is normally in Send Mode.  We switch to Command Mode first.
-  if (!enterCommandMode()) return false;
-  //  Confirm we are in COMMAND_MODE
-  if (mode != COMMAND_MODE) {
-    log1(F(" - Warning: Radiocrafts.enterConfigMode did not detect expected Command Mode, may be in incorrect mode"));
+bool Radiocrafts::switchMode(Mode target) {
+  //  Switch the module to the target mode, one step at a time:
+  //  Send Mode <-> Command Mode <-> Config Mode.  Does nothing if the module is
+  //  already in the target mode.  If a step fails, the mode is unknown, so we
+  //  resync to Send Mode and try again, up to RADIOCRAFTS_MODE_RETRIES times.
+  for (uint8_t retry = 0; mode != target;) {
+    if (switchModeStep(target)) continue;
+    mode = UNKNOWN_MODE;
+    if (++retry >= RADIOCRAFTS_MODE_RETRIES) {
+      log1(F(" - Radiocrafts.switchMode: Error: Module not responding"));
+      return false;
+    }
   }
-  //  Now switch from Command Mode to Config Mode.
-  log1(F(" - Entering config mode from send mode..."));
-  uint8_t markers = 0;
-  if (!sendBuffer(toHex(CMD_ENTER_CONFIG), COMMAND_TIMEOUT, 1, modeData, markers)) return false;
-  mode = CONFIG_MODE;
-  log1(F(" - Radiocrafts.enterConfigMode: OK "));
   return true;
 }
 
-bool Radiocrafts::exitConfigMode() {
-  //  Exit Config Mode and return to Send Mode so we can send data.
-  //  We exit to Command Mode first.
-  log1(F(" - Exiting config mode to send mode..."));
-  //  Confirm we are in CONFIG_MODE
-  if (mode != CONFIG_MODE) {
-    log1(F(" - Warning: Radiocrafts.exitConfigMode did not detect expected Config Mode, may be in incorrect mode"));
+bool Radiocrafts::switchModeStep(Mode target) {
+  //  Make one mode switch towards the target mode.  Return false if the module
+  //  did not respond as expected.
+  static const uint8_t enterCommand[] = { CMD_ENTER_COMMAND }, exitCommand[] = { CMD_EXIT_COMMAND },
+    enterConfig[] = { CMD_ENTER_CONFIG }, exitConfig[] = { CMD_EXIT_CONFIG, CMD_EXIT_CONFIG };
+  uint8_t markers = 0;
+  switch (mode) {
+    case SEND_MODE:
+      log1(F(" - Entering command mode..."));
+      if (!sendBuffer(enterCommand, 1, COMMAND_TIMEOUT, 1, markers)) return false;
+      mode = COMMAND_MODE;
+      return true;
+
+    case COMMAND_MODE:
+      if (target == CONFIG_MODE) {
+        log1(F(" - Entering config mode..."));
+        if (!sendBuffer(enterConfig, 1, COMMAND_TIMEOUT, 1, markers)) return false;
+        mode = CONFIG_MODE;
+        return true;
+      }
+      //  Send Mode does not respond.
+      log1(F(" - Exiting command mode..."));
+      if (!sendBuffer(exitCommand, 1, COMMAND_TIMEOUT, 0, markers)) return false;
+      if (responseLength != 0 || markers != 0) return false;
+      mode = SEND_MODE;
+      return true;
+
+    case CONFIG_MODE:
+      log1(F(" - Exiting config mode..."));
+      if (!sendBuffer(exitConfig, 1, COMMAND_TIMEOUT, 1, markers)) return false;
+      mode = COMMAND_MODE;
+      return true;
+
+    default:
+      //  Mode unknown.  Two 0xff bytes finish any config write and exit Config Mode,
+      //  then 'X' exits Command Mode.  Send Mode ignores these bytes because they
+      //  are not valid payload lengths.
+      log1(F(" - Warning: Radiocrafts mode unknown, returning to send mode"));
+      modeResyncs++;
+      sendBuffer(exitConfig, 2, COMMAND_TIMEOUT, 0, markers);
+      sendBuffer(exitCommand, 1, COMMAND_TIMEOUT, 0, markers);
+      mode = SEND_MODE;
+      return true;
   }
+}
+
+bool Radiocrafts::probeBitsPerSecond() {
+  //  Send 0x00 at the current rate.  From Send Mode it enters Command Mode, in
+  //  Command Mode it is an unknown command.  Either way the module prompts with '>'.
+  static const uint8_t probe[] = { CMD_ENTER_COMMAND };
   uint8_t markers = 0;
-  if (!sendBuffer(toHex(CMD_EXIT_CONFIG), COMMAND_TIMEOUT, 1, modeData, markers)) return false;
+  if (!sendBuffer(probe, sizeof(probe), COMMAND_TIMEOUT, 1, markers)) return false;
   mode = COMMAND_MODE;
-  log1(F(" - Radiocrafts.exitConfigMode: OK "));
-  //  Then exit to Send Mode.
-  exitCommandMode();
   return true;
 }
 
+bool Radiocrafts::detectBitsPerSecond() {
+  //  Find the UART rate of the module: the current rate first, then from the fastest.
+  //  Return true if the module responded.
+  if (useEmulator) return true;  //  Nothing is sent to the module.
+  const unsigned long current = bitsPerSecond;
+  for (uint8_t i = 0; i <= uartRateCount; i++) {
+    if (i > 0) {
+      bitsPerSecond = 100UL * pgm_read_word(&uartRates[uartRateCount - i]);
+      if (bitsPerSecond == current) continue;
+    }
+    if (probeBitsPerSecond()) {
+      log2(F(" - Radiocrafts.detectBitsPerSecond: "), bitsPerSecond);
+      return true;
+    }
+  }
+  bitsPerSecond = current;
+  return false;
+}
+
+bool Radiocrafts::setBitsPerSecond(unsigned long bps) {
+  //  Write the UART rate to the module config, which the module keeps, so that it
+  //  starts at this rate next time and detectBitsPerSecond() tries it first.  The
+  //  new rate is used after leaving Config Mode.  Return true if the module
+  //  responds at the new rate.
+  uint8_t code = 0;
+  for (uint8_t i = 0; i < uartRateCount; i++)
+    if (100UL * pgm_read_word(&uartRates[i]) == bps) code = i + 1;
+  if (code == 0) {
+    log2(F(" - Radiocrafts.setBitsPerSecond: Error: Unsupported rate "), bps);
+    return false;
+  }
+  if (useEmulator) { bitsPerSecond = bps; return true; }
+  if (!writeConfig(CONFIG_UART_BAUD, code)) return false;  //  Read back below at the new rate.
+  if (!switchMode(COMMAND_MODE)) return false;  //  Exit Config Mode at the old rate.
+
+  //  Read back the UART_BAUD at the new rate.  Expect 1 marker for command, 1 for response.
+  const unsigned long old = bitsPerSecond;
+  bitsPerSecond = bps;
+  const uint8_t cmd[] = { CMD_READ_MEMORY, CONFIG_UART_BAUD };
+  uint8_t markers = 0;
+  if (sendBuffer(cmd, sizeof(cmd), COMMAND_TIMEOUT, 2, markers)
+      && responseLength == 1 && response[0] == code) {
+    log2(F(" - Radiocrafts.setBitsPerSecond: "), bitsPerSecond);
+    return true;
+  }
+  //  The module may use the new rate only after a reset.  Stay at the old rate until then.
+  log1(F(" - Radiocrafts.setBitsPerSecond: Warning: Module not responding at the new rate"));
+  bitsPerSecond = old;
+  return false;
+}
+
 bool Radiocrafts::getID(String &id, String &pac) {
   //  Get the SIGFOX ID and PAC for the module.
+  static const uint8_t cmd[] = { CMD_READ_ID };
   uint8_t markers = 0;
-  if (!sendCommand(toHex('9'), 1, data, markers)) return false;
+  if (!sendCommand(cmd, sizeof(cmd), 1, markers)) return false;
   //  Returns with 12 bytes: 4 bytes ID (LSB first) and 8 bytes PAC (MSB first).
-  if (data.length() != 12 * 2) {
+  if (responseLength != 12) {
     if (useEmulator) { id = device; return true; }
-    log2(F(" - Radiocrafts.getID: Unknown response: "), data);
+    log2(F(" - Radiocrafts.getID: Unknown response: "), responseToHex());
     return false;
   }
-  id = data.substring(6, 8) + data.substring(4, 6) + data.substring(2, 4) + data.substring(0, 2);
-  pac = data.substring(8, 8 + 16);
+  const uint8_t idBytes[] = { response[3], response[2], response[1], response[0] };
+  char hex[16 + 1];
+  bytesToHex(idBytes, 4, hex);  hex[8] = 0;
+  id = hex;
+  bytesToHex(response + 4, 8, hex);  hex[16] = 0;
+  pac = hex;
   device = id;
   log2(F(" - Radiocrafts.getID: returned id="), id + ", pac=" + pac);
   return true;
@@ -396,30 +543,30 @@ bool Radiocrafts::getID(String &id, String &pac) {
 
 bool Radiocrafts::getTemperature(int &temperature) {
   //  Returns the temperature of the SIGFOX module.
+  static const uint8_t cmd[] = { CMD_READ_TEMPERATURE };
   uint8_t markers = 0;
-  if (!sendCommand(toHex('U'), 1, data, markers)) return false;
-  if (data.length() != 2) {
+  if (!sendCommand(cmd, sizeof(cmd), 1, markers)) return false;
+  if (responseLength != 1) {
     if (useEmulator) { temperature = 36; return true; }
-    log2(F(" - Radiocrafts.getTemperature: Unknown response: "), data);
+    log2(F(" - Radiocrafts.getTemperature: Unknown response: "), responseToHex());
     return false;
   }
-  temperature = hexDigitToDecimal(data.charAt(0)) * 16 +
-                   hexDigitToDecimal(data.charAt(1)) - 128;
+  temperature = response[0] - 128;
   log2(F(" - Radiocrafts.getTemperature: returned "), temperature);
   return true;
 }
 
 bool Radiocrafts::getVoltage(float &voltage) {
   //  Returns one byte indicating the power supply voltage.
+  static const uint8_t cmd[] = { CMD_READ_VOLTAGE };
   uint8_t markers = 0;
-  if (!sendCommand(toHex('V'), 1, data, markers)) return false;
-  if (data.length() != 2) {
+  if (!sendCommand(cmd, sizeof(cmd), 1, markers)) return false;
+  if (responseLength != 1) {
     if (useEmulator) { voltage = 12.3; return true; }
-    log2(F(" - Radiocrafts.getVoltage: Unknown response: "), data);
+    log2(F(" - Radiocrafts.getVoltage: Unknown response: "), responseToHex());
     return false;
   }
-  voltage = 0.030 * (hexDigitToDecimal(data.charAt(0)) * 16 +
-                hexDigitToDecimal(data.charAt(1)));
+  voltage = 0.030 * response[0];
   log2(F(" - Radiocrafts.getVoltage: returned "), voltage);
   return true;
 }
@@ -441,12 +588,12 @@ bool Radiocrafts::getFirmware(String &firmware) {
 bool Radiocrafts::getParameter(uint8_t address, String &value) {
   //  Read the parameter at the address.
   log2(F(" - Radiocrafts.getParameter: address=0x"), toHex((char) address));
+  const uint8_t cmd[] = { CMD_READ_MEMORY, address };  //  Read memory ('Y') at the address of parameter.
   uint8_t markers = 0;
-  if (!sendCommand(toHex(CMD_READ_MEMORY) +   //  Read memory ('Y')
-                   toHex((char) address),  //  Address of parameter
+  if (!sendCommand(cmd, sizeof(cmd),
                    2,  //  Expect 1 marker for command, 1 for response.
-                   data, markers)) return false;
-  value = data;
+                   markers)) return false;
+  value = responseToHex();
   log4(F(" - Radiocrafts.getParameter: address=0x"), toHex((char) address), F(" returned "), value);
   return true;
 }
@@ -477,9 +624,9 @@ bool Radiocrafts::getEmulator(int &result) {
 bool Radiocrafts::disableEmulator(String &result) {
   //  Set the module key to the unique SIGFOX key.  This is needed for sending
   //  to a real SIGFOX base station.
-  if (!sendConfigCommand(String() +
-      "28" + //  Address of parameter = PUBLIC_KEY (0x28)
-      "00",  //  Value of parameter = Unique ID & key (0x00)
+  if (!sendConfigCommand(
+      0x28,  //  Address of parameter = PUBLIC_KEY (0x28)
+      0x00,  //  Value of parameter = Unique ID & key (0x00)
       data)) return false;
   result = data;
   return true;
@@ -488,9 +635,9 @@ bool Radiocrafts::disableEmulator(String &result) {
 bool Radiocrafts::enableEmulator(String &result) {
   //  Set the module key to the public key.  This is needed for sending
   //  to an emulator.
-  if (!sendConfigCommand(String() +
-      "28" + //  Address of parameter = PUBLIC_KEY (0x28)
-      "01",  //  Value of parameter = Public ID & key (0x00)
+  if (!sendConfigCommand(
+      0x28,  //  Address of parameter = PUBLIC_KEY (0x28)
+      0x01,  //  Value of parameter = Public ID & key (0x01)
       data)) return false;
   result = data;
   return true;
@@ -501,9 +648,10 @@ bool Radiocrafts::getFrequency(String &result) {
   //  0: Europe (RCZ1)
   //  1: US (RCZ2)
   //  3: SG, TW, AU, NZ (RCZ4)
+  static const uint8_t cmd[] = { CMD_READ_MEMORY, 0x00 };  //  Address of parameter = RF_FREQUENCY_DOMAIN (0x0)
   uint8_t markers = 0;
-  if (!sendCommand(toHex(CMD_READ_MEMORY) + "00", 1, data, markers)) return false;
-  result = data;
+  if (!sendCommand(cmd, sizeof(cmd), 1, markers)) return false;
+  result = responseToHex();
   return true;
 }
 
@@ -512,9 +660,9 @@ bool Radiocrafts::setFrequency(int zone, String &result) {
   //  0: Europe (RCZ1)
   //  1: US (RCZ2)
   //  3: AU/NZ (RCZ4)
-  if (!sendConfigCommand(String() +
-    "00" + //  Address of parameter = RF_FREQUENCY_DOMAIN (0x0)
-    toHex((char) (zone - 1)),  //  Value of parameter = RCZ - 1
+  if (!sendConfigCommand(
+    0x00,  //  Address of parameter = RF_FREQUENCY_DOMAIN (0x0)
+    zone - 1,  //  Value of parameter = RCZ - 1
     data)) return false;
   result = data;
   return true;
@@ -563,6 +711,12 @@ void Radiocrafts::echoOff() {
   lastEchoPort = echoPort; echoPort = &nullPort;
 }
 
+void Radiocrafts::setCaptureHook(SerialCaptureHook hook, void *context) {
+  //  Capture the bytes sent to and received from the module.
+  captureHook = hook;
+  captureContext = context;
+}
+
 void Radiocrafts::setEchoPort(Print *port) {
   //  Set the port for sending echo output.
   lastEchoPort = echoPort;
@@ -666,40 +820,26 @@ String Radiocrafts::toHex(char *c, int length) {
   return bytes;
 }
 
-uint8_t Radiocrafts::hexDigitToDecimal(char ch) {
-  //  Convert 0..9, a..f, A..F to decimal.
-  if (ch >= '0' && ch <= '9') return (uint8_t) ch - '0';
-  if (ch >= 'a' && ch <= 'z') return (uint8_t) ch - 'a' + 10;
-  if (ch >= 'A' && ch <= 'Z') return (uint8_t) ch - 'A' + 10;
-  log2(F(" - Radiocrafts.hexDigitToDecimal: Error: Invalid hex digit "), ch);
-  return 0;
-}
-
 //  Convert nibble to hex digit.
 static const char nibbleToHex[] = "0123456789abcdef";
 
-void Radiocrafts::logBuffer(const __FlashStringHelper *prefix, const char *buffer,
+void Radiocrafts::logBuffer(const __FlashStringHelper *prefix, const uint8_t *buffer, uint8_t length,
                             uint8_t *markerPos, uint8_t markerCount) {
-  //  Log the send/receive buffer for debugging.  markerPos is an array of positions in buffer
-  //  where the '>' marker was seen and removed.
+  //  Log the send/receive buffer in hex for debugging.  markerPos is an array of positions
+  //  in buffer where the '>' marker was seen and removed.
   echoPort->print(prefix);
   int m = 0, i = 0;
-  for (i = 0; i < strlen(buffer); i = i + 2) {
+  for (i = 0; i <= length; i++) {
     if (m < markerCount && markerPos[m] == i) {
       echoPort->write((uint8_t) nibbleToHex[END_OF_RESPONSE / 16]);
       echoPort->write((uint8_t) nibbleToHex[END_OF_RESPONSE % 16]);
       echoPort->write(' ');
       m++;
     }
-    echoPort->write((uint8_t) buffer[i]);
-    echoPort->write((uint8_t) buffer[i + 1]);
-    echoPort->write(' ');
-  }
-  if (m < markerCount && markerPos[m] == i) {
-    echoPort->write((uint8_t) nibbleToHex[END_OF_RESPONSE / 16]);
-    echoPort->write((uint8_t) nibbleToHex[END_OF_RESPONSE % 16]);
+    if (i == length) break;
+    echoPort->write((uint8_t) nibbleToHex[buffer[i] / 16]);
+    echoPort->write((uint8_t) nibbleToHex[buffer[i] % 16]);
     echoPort->write(' ');
-    m++;
   }
   echoPort->write('\n');
 }
@@ -12,7 +12,8 @@
   #ifdef CLION
     #include <src/SoftwareSerial.h>
   #else  //  CLION
-    #ifndef BEAN_BEAN_BEAN_H
+    #if !defined(BEAN_BEAN_BEAN_H) && (!defined(SIGFOX_SERIAL_PORT) || defined(SIGFOX_SERIAL_SOFTWARE))
+      //  Not needed for a hardware UART, see SerialPort.h.
       //  Bean+ firmware 0.6.1 can't receive serial data properly. We provide
       //  an alternative class BeanSoftwareSerial to work around this.
       //  See SIGFOX.h.
@@ -23,6 +24,9 @@
 #else  //  ARDUINO
 #endif  //  ARDUINO
 
+#include "SerialPort.h"
+#include "Histogram.h"
+
 const uint8_t RADIOCRAFTS_TX = 4;  //  Transmit port for For UnaBiz / Radiocrafts Dev Kit
 const uint8_t RADIOCRAFTS_RX = 5;  //  Receive port for UnaBiz / Radiocrafts Dev Kit
 
@@ -30,7 +34,11 @@ enum Mode {
   SEND_MODE = 0,
   COMMAND_MODE = 1,
   CONFIG_MODE = 2,
+  UNKNOWN_MODE = 3,  //  After a failed mode switch, until the module is back in Send Mode.
 };
+const uint8_t RADIOCRAFTS_MODE_RETRIES = 3;  //  Give up switching modes after this many resyncs.
+const unsigned long RADIOCRAFTS_BITS_PER_SECOND = 19200;  //  Factory default UART rate of the module.
+const uint8_t RADIOCRAFTS_BUFFER_MAX = 32;  //  Max number of response bytes kept, excluding '>' markers.
 
 class Radiocrafts
 {
@@ -38,17 +46,29 @@ public:
   Radiocrafts(Country country, bool useEmulator, const String device, bool echo);
   Radiocrafts(Country country, bool useEmulator, const String device, bool echo,
               uint8_t rx, uint8_t tx);
+  Radiocrafts(Country country, bool useEmulator, const String device, bool echo,
+              SIGFOX_SERIAL_PORT *port);  //  Use this port, e.g. a Linux serial device.
   bool begin();
   void echoOn();  //  Turn on send/receive echo.
   void echoOff();  //  Turn off send/receive echo.
   void setEchoPort(Print *port);  //  Set the port for sending echo output.
+  void setCaptureHook(SerialCaptureHook hook, void *context);  //  Capture the bytes sent and received.  0 to stop.
   void echo(const String &msg);  //  Echo the debug message.
   bool isReady();
+  LatencyHistogram &getLatency() { return latency; }  //  Response latency of all commands, to dump or pack.
   bool sendMessage(const String &payload);  //  Send the payload of hex digits to the network, max 12 bytes.
+  bool sendBytes(const uint8_t *payload, uint8_t length);  //  Send the binary payload to the network, max 12 bytes.
+  const uint8_t *getResponse() const { return response; }  //  Response bytes of the last command, without markers.
+  uint8_t getResponseLength() const { return responseLength; }
   bool sendString(const String &str);  //  Sending a text string, max 12 characters allowed.
   bool receive(String &data);  //  Receive a message.
   bool enterCommandMode();  //  Enter Command Mode for sending module commands, not data.
   bool exitCommandMode();  //  Exit Command Mode and return to Send Mode so we can send data.
+  Mode getMode() const { return mode; }  //  Mode that the module is in.  Commands stay in their mode.
+  unsigned long getModeResyncs() const { return modeResyncs; }  //  Number of times the mode was lost.
+  bool detectBitsPerSecond();  //  Find the UART rate of the module.  Done by begin().  Leaves Command Mode on.
+  bool setBitsPerSecond(unsigned long bitsPerSecond);  //  Switch the module UART, e.g. to 115200.  Kept by the module.
+  unsigned long getBitsPerSecond() const { return bitsPerSecond; }  //  UART rate of the module.
 
   //  Commands for the module, must be run in Command Mode.
   bool getEmulator(int &result);  //  Return 0 if emulator mode disabled, else return 1.
@@ -86,26 +106,42 @@ public:
   String toHex(char *c, int length);
 
 private:
-  bool sendCommand(const String &cmd, uint8_t expectedMarkers,
-                   String &result, uint8_t &actualMarkers);
-  bool sendConfigCommand(const String &cmd, String &result);
-  bool sendBuffer(const String &buffer, int timeout, uint8_t expectedMarkers,
-                  String &dataOut, uint8_t &actualMarkers);
+  bool sendCommand(const uint8_t *cmd, uint8_t length, uint8_t expectedMarkers,
+                   uint8_t &actualMarkers);
+  bool sendConfigCommand(uint8_t address, uint8_t value, String &result);  //  Write and read back.
+  bool writeConfig(uint8_t address, uint8_t value);
+  bool sendBuffer(const uint8_t *buffer, uint8_t length, int timeout, uint8_t expectedMarkers,
+                  uint8_t &actualMarkers);
+  String responseToHex();
   bool setFrequency(int zone, String &result);
-  bool enterConfigMode();  //  Enter Config Mode for setting config.
-  bool exitConfigMode();  //  Exit Config Mode and return to Send Mode so we can send data.
-  uint8_t hexDigitToDecimal(char ch);
-  void logBuffer(const __FlashStringHelper *prefix, const char *buffer,
+  bool switchMode(Mode target);  //  Switch to the mode unless already there, resync if needed.
+  bool switchModeStep(Mode target);
+  bool probeBitsPerSecond();
+  uint8_t commandType(uint8_t cmd);
+  void logBuffer(const __FlashStringHelper *prefix, const uint8_t *buffer, uint8_t length,
                  uint8_t markerPos[], uint8_t markerCount);
 
   Mode mode;  //  Current mode: command or send mode.
+  unsigned long modeResyncs;  //  Number of times the mode was unknown and resynced.
+  unsigned long bitsPerSecond;  //  UART rate of the module.
   Country country;   //  Country to be set for SIGFOX transmission frequencies.
   bool useEmulator;  //  Set to true if using UnaBiz Emulator.
   String device;  //  Name of device if using UnaBiz Emulator.
-  SoftwareSerial *serialPort;  //  Serial port for the SIGFOX module.
+  SIGFOX_SERIAL_PORT *serialPort;  //  Serial port for the SIGFOX module.
   Print *echoPort;  //  Port for sending echo output.  Defaults to Serial.
   Print *lastEchoPort;  //  Last port used for sending echo output.
   unsigned long lastSend;  //  Timestamp of last send.
+  SerialCaptureHook captureHook;  //  Called for each byte sent and received, if set.
+  void *captureContext;
+  LatencyHistogram latency;  //  Response latency of all commands by type.
+  //  Responses kept per transceiver so that many transceivers may run on separate
+  //  threads when simulated on Linux.
+  String data;  //  Used by the config functions.
+  uint8_t response[RADIOCRAFTS_BUFFER_MAX];  //  Response bytes of the last command, without markers.
+  uint8_t responseLength;
+  //  Remember where in response the '>' markers were seen.
+  static const uint8_t markerPosMax = 5;
+  uint8_t markerPos[markerPosMax];
 };
 
 #endif // UNABIZ_ARDUINO_RADIOCRAFTS_H
@@ -44,7 +44,7 @@ enum Country {
 
 //  Drop all data passed to this port.  Used to suppress echo output.
 class NullPort: public Print {
-  virtual size_t write(uint8_t) {}
+  virtual size_t write(uint8_t) { return 1; }
 };
 
 //  Call this function if we need to stop.  This informs the emulator to stop listening.
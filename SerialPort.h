@@ -0,0 +1,100 @@
+//  Serial port used by the transceiver drivers to talk to the SIGFOX module.
+//  On Arduino this is SoftwareSerial (BeanSoftwareSerial on Bean+, see SIGFOX.h).
+//  When built natively on Linux (UNABIZ_HOST) it is SerialStream, implemented by
+//  TermiosSerial for a module on a USB UART and by SoftwareSerial for a simulated module.
+//
+//  Boards with a free hardware UART (Leonardo, Mega, SAMD) may use it instead, chosen
+//  at compile time so there are no virtual calls.  Define in the build flags, since
+//  the Arduino IDE doesn't pass sketch #defines to libraries:
+//    -DSIGFOX_SERIAL_PORT=HardwareSerial -DSIGFOX_SERIAL_DEVICE=Serial1  (Uart on SAMD)
+//  For any other Stream that the sketch opens and closes itself, also define
+//  SIGFOX_SERIAL_STREAM and the drivers won't call begin() or end().
+//  The rx, tx pins passed to the driver constructors are ignored for these ports.
+//  Opt-in: also define SIGFOX_SERIAL_FAST_BITS_PER_SECOND, e.g. 115200, and the
+//  Radiocrafts begin() switches the module to that UART rate.  The rate is written
+//  to the module's nonvolatile config, so the module keeps it after a reset.
+#ifndef UNABIZ_ARDUINO_SERIALPORT_H
+#define UNABIZ_ARDUINO_SERIALPORT_H
+
+#ifdef UNABIZ_HOST
+  #include "SerialStream.h"
+  #define SIGFOX_SERIAL_PORT SerialStream
+  #define SIGFOX_SERIAL_SOFTWARE  //  Behaves like SoftwareSerial, including the pacing.
+#elif !defined(SIGFOX_SERIAL_PORT)
+  #define SIGFOX_SERIAL_PORT SoftwareSerial
+  #define SIGFOX_SERIAL_SOFTWARE
+#else  //  UNABIZ_HOST
+  #ifndef SIGFOX_SERIAL_DEVICE
+    #define SIGFOX_SERIAL_DEVICE Serial1
+  #endif  //  SIGFOX_SERIAL_DEVICE
+#endif  //  UNABIZ_HOST
+
+//  Port for the module on the rx, tx pins.
+#ifdef SIGFOX_SERIAL_SOFTWARE
+  #define SIGFOX_SERIAL_OPEN(rx, tx) (new SoftwareSerial(rx, tx))
+#else  //  SIGFOX_SERIAL_SOFTWARE
+  #define SIGFOX_SERIAL_OPEN(rx, tx) (&SIGFOX_SERIAL_DEVICE)
+#endif  //  SIGFOX_SERIAL_SOFTWARE
+
+//  On Bean built with -D_SS_TIMER_TX, write() only queues the byte and Timer2 sends
+//  it, with a character of idle time after each byte for the echo.
+#if defined(BEAN_BEAN_BEAN_H) && defined(SIGFOX_SERIAL_SOFTWARE) && defined(_SS_TIMER_TX)
+  #define SIGFOX_SERIAL_QUEUED
+#endif  //  BEAN_BEAN_BEAN_H && SIGFOX_SERIAL_SOFTWARE && _SS_TIMER_TX
+
+//  Pause after each byte sent.  SoftwareSerial has no FIFO and the module may
+//  overflow; a hardware UART needs no pacing, nor does a queued port, which
+//  paces the bytes itself and would have to drain before sleeping.
+#if defined(SIGFOX_SERIAL_SOFTWARE) && !defined(SIGFOX_SERIAL_QUEUED)
+  #define SIGFOX_SERIAL_PACING(milliSeconds) (milliSeconds)
+#else  //  SIGFOX_SERIAL_SOFTWARE && !SIGFOX_SERIAL_QUEUED
+  #define SIGFOX_SERIAL_PACING(milliSeconds) 0
+#endif  //  SIGFOX_SERIAL_SOFTWARE && !SIGFOX_SERIAL_QUEUED
+
+//  Open and close the port, unless the sketch does it (SIGFOX_SERIAL_STREAM).
+//  serialBegin() returns false if the port can't run at the rate, e.g. a Linux
+//  serial device at a rate termios doesn't have.
+inline bool serialBegin(SIGFOX_SERIAL_PORT *port, unsigned long bitsPerSecond) {
+#ifndef SIGFOX_SERIAL_STREAM
+  port->clearWriteError();
+  port->begin(bitsPerSecond);
+  return !port->getWriteError();
+#else  //  SIGFOX_SERIAL_STREAM
+  return true;
+#endif  //  SIGFOX_SERIAL_STREAM
+}
+
+inline void serialEnd(SIGFOX_SERIAL_PORT *port) {
+#ifndef SIGFOX_SERIAL_STREAM
+  port->end();
+#endif  //  SIGFOX_SERIAL_STREAM
+}
+
+inline void serialListen(SIGFOX_SERIAL_PORT *port) {
+  //  Drop the bytes received so far and listen on the port.  SoftwareSerial::flush()
+  //  drops the received bytes, but Stream::flush() waits for the bytes sent.
+#ifdef SIGFOX_SERIAL_SOFTWARE
+  port->flush();
+  port->listen();
+#else  //  SIGFOX_SERIAL_SOFTWARE
+  while (port->available() > 0) port->read();
+#endif  //  SIGFOX_SERIAL_SOFTWARE
+}
+
+//  Called for each byte sent to the module (transmit = true) and received from the
+//  module, e.g. to capture the serial traffic for replay (see test/Capture.h).
+//  Must be quick: it runs inside the send / receive loop.
+typedef void (*SerialCaptureHook)(void *context, bool transmit, uint8_t ch);
+
+//  Wait up to timeout milliseconds for data from the module.  Returns true if data is
+//  available.  SoftwareSerial receives by interrupt so we only check, and the caller
+//  loops until its timeout.  On Linux we block in poll() instead of spinning.
+inline bool waitForSerial(SIGFOX_SERIAL_PORT *port, unsigned long timeout) {
+#ifdef UNABIZ_HOST
+  return port->waitAvailable(timeout);
+#else  //  UNABIZ_HOST
+  return port->available() > 0;
+#endif  //  UNABIZ_HOST
+}
+
+#endif  //  UNABIZ_ARDUINO_SERIALPORT_H
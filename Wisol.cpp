@@ -8,6 +8,7 @@
 #endif  //  ARDUINO
 
 #include "SIGFOX.h"
+#include "Hex.h"
 
 //  Use a macro for logging because Flash strings not supported with String class in Bean+
 #define log1(x) { echoPort->println(x); }
@@ -16,36 +17,127 @@
 #define log4(x, y, z, a) { echoPort->print(x); echoPort->print(y); echoPort->print(z); echoPort->println(a); }
 
 #define MODEM_BITS_PER_SECOND 9600  //  Connect to modem at this bps.
-#define END_OF_RESPONSE '\r'  //  Character '\r' marks the end of response.
-#define CMD_OUTPUT_POWER_MAX "ATS302=15"  //  For RCZ1: Set output power to maximum power level.
-#define CMD_PRESEND "AT$GI?"  //  For RCZ2, 4: Send this command before sending messages.  Returns X,Y.
-#define CMD_PRESEND2 "AT$RC"  //  For RCZ2, 4: Send this command if presend returns X=0 or Y<3.
-#define CMD_SEND_MESSAGE "AT$SF="  //  Prefix to send a message to SIGFOX cloud.
-#define CMD_SEND_MESSAGE_RESPONSE ",1"  //  Expect downlink response from SIGFOX.
-#define CMD_GET_ID "AT$I=10"  //  Get SIGFOX device ID.
-#define CMD_GET_PAC "AT$I=11"  //  Get SIGFOX device PAC, used for registering the device.
-#define CMD_GET_TEMPERATURE "AT$T?"  //  Get the module temperature.
-#define CMD_GET_VOLTAGE "AT$V?"  //  Get the module voltage.
-#define CMD_RESET "AT$P=0"  //  Software reset.
-#define CMD_SLEEP "AT$P=1"  //  TODO: Switch to sleep mode : consumption is < 1.5uA
-#define CMD_WAKEUP "AT$P=0"  //  TODO: Switch back to normal mode : consumption is 0.5 mA
-#define CMD_END "\r"
-#define CMD_RCZ1 "AT$IF=868130000"  //  EU / RCZ1 Frequency
-#define CMD_RCZ2 "AT$IF=902200000"  //  US / RCZ2 Frequency
-#define CMD_RCZ3 "AT$IF=902080000"  //  JP / RCZ3 Frequency
-#define CMD_RCZ4 "AT$IF=920800000"  //  RCZ4 Frequency
-#define CMD_MODULATION_ON "AT$CB=-1,1"  //  Modulation wave on.
-#define CMD_MODULATION_OFF "AT$CB=-1,0"  //  Modulation wave off.
-#define CMD_EMULATOR_DISABLE "ATS410=0"  //  Device will only talk to Sigfox network.
-#define CMD_EMULATOR_ENABLE "ATS410=1"  //  Device will only talk to SNEK emulator.
 
 static NullPort nullPort;
-static uint8_t markers = 0;
-static String data;
 
-//  Remember where in response the '>' markers were seen.
-const uint8_t markerPosMax = 5;
-static uint8_t markerPos[markerPosMax];
+//  Settings for each zone.  The X,Y check with AT$GI? and AT$RC is needed for FCC
+//  frequency hopping in RCZ2 and 4.
+static constexpr ZoneProfile zoneProfiles[] = {
+  //  zone, outputPower, channelReset, downlink, transmitCurrent
+  { 1, CMD_OUTPUT_POWER_MAX, false, true, 49 },  //  Europe
+  { 2, 0, true, true, 227 },  //  US
+  { 3, CMD_OUTPUT_POWER_MAX, false, true, 65 },  //  Japan
+  { 4, 0, true, true, 227 },  //  SG, TW, AU, NZ, BR
+};
+
+//  Approximate supply current (mA) of the module when not transmitting.
+static const float sleepCurrent = 0.0015;
+static const float idleCurrent = 0.5;
+static const float receiveCurrent = 10;
+
+//  Countries outside RCZ4.
+static constexpr struct { Country country; uint8_t zone; } countryZones[] = {
+  { COUNTRY_FR, 1 }, { COUNTRY_OM, 1 }, { COUNTRY_SA, 1 },
+  { COUNTRY_US, 2 },
+  { COUNTRY_JP, 3 },
+};
+
+//  Parse callbacks for the responses.
+static bool parseChannel(const ATParser &response, void *result) {
+  //  AT$GI? returns X,Y e.g. "1,6".
+  const char *data = response.getData();
+  if (response.getDataLength() < 3) return false;
+  ((int8_t *) result)[0] = data[0] - '0';
+  ((int8_t *) result)[1] = data[2] - '0';
+  return true;
+}
+
+static bool parseTemperature(const ATParser &response, void *result) {
+  //  AT$T? returns tenths of a degree, e.g. "322".
+  if (response.getDataLength() == 0) return false;
+  *(float *) result = atoi(response.getData()) / 10.0;
+  return true;
+}
+
+static bool parseVoltage(const ATParser &response, void *result) {
+  //  AT$V? returns millivolts, e.g. "3300".
+  if (response.getDataLength() == 0) return false;
+  *(float *) result = atof(response.getData()) / 1000.0;
+  return true;
+}
+
+static bool parseDownlink(const ATParser &response, void *result) {
+  //  Downlink is returned as "RX=01 23 45 67 89 AB CD EF".  Return it as hex digits
+  //  without spaces, in uppercase like the module.
+  if (response.getDownlinkLength() == 0) return false;
+  char hex[AT_DOWNLINK_MAX * 2 + 1];
+  bytesToHex(response.getDownlink(), response.getDownlinkLength(), hex);
+  hex[response.getDownlinkLength() * 2] = 0;
+  String &downlink = *(String *) result;
+  downlink = hex;
+  downlink.toUpperCase();
+  return true;
+}
+
+//  AT commands for the Wisol module, run by ATEngine.  Each response is one line ending
+//  with '\r', e.g. "OK" or "322", except for the downlink which follows the OK.
+static const char textAT[] PROGMEM = CMD_AT;
+static const char textSendMessage[] PROGMEM = CMD_SEND_MESSAGE;
+static const char textSendMessageResponse[] PROGMEM = CMD_SEND_MESSAGE_RESPONSE;
+static const char textPresend[] PROGMEM = CMD_PRESEND;
+static const char textPresend2[] PROGMEM = CMD_PRESEND2;
+static const char textGetID[] PROGMEM = CMD_GET_ID;
+static const char textGetPAC[] PROGMEM = CMD_GET_PAC;
+static const char textGetTemperature[] PROGMEM = CMD_GET_TEMPERATURE;
+static const char textGetVoltage[] PROGMEM = CMD_GET_VOLTAGE;
+static const char textReset[] PROGMEM = CMD_RESET;
+static const char textSleep[] PROGMEM = CMD_SLEEP;
+static const char textEmulatorDisable[] PROGMEM = CMD_EMULATOR_DISABLE;
+static const char textEmulatorEnable[] PROGMEM = CMD_EMULATOR_ENABLE;
+static const char textNone[] PROGMEM = "";  //  Whole command is in the argument.
+
+static const ATCommand cmdAT PROGMEM =
+  { textAT, 0, 1, AT_LINE_NONE, COMMAND_TIMEOUT, COMMAND_OTHER, 0 };
+static const ATCommand cmdSendMessage PROGMEM =
+  { textSendMessage, 0, 1, AT_LINE_NONE, WISOL_COMMAND_TIMEOUT, COMMAND_SEND, 0 };
+static const ATCommand cmdSendMessageResponse PROGMEM =  //  "OK" then "RX=..."
+  { textSendMessage, textSendMessageResponse, 2, AT_LINE_NONE, WISOL_COMMAND_TIMEOUT, COMMAND_SEND, parseDownlink };
+static const ATCommand cmdPresend PROGMEM =
+  { textPresend, 0, 1, AT_LINE_NONE, WISOL_COMMAND_TIMEOUT, COMMAND_PRESEND, parseChannel };
+static const ATCommand cmdPresend2 PROGMEM =
+  { textPresend2, 0, 1, AT_LINE_NONE, WISOL_COMMAND_TIMEOUT, COMMAND_PRESEND, 0 };
+static const ATCommand cmdOutputPower PROGMEM =  //  Command from the zone profile.
+  { textNone, 0, 1, AT_LINE_NONE, WISOL_COMMAND_TIMEOUT, COMMAND_PRESEND, 0 };
+static const ATCommand cmdGetID PROGMEM =
+  { textGetID, 0, 1, AT_LINE_NONE, WISOL_COMMAND_TIMEOUT, COMMAND_ID, atParseString };
+static const ATCommand cmdGetPAC PROGMEM =
+  { textGetPAC, 0, 1, AT_LINE_NONE, WISOL_COMMAND_TIMEOUT, COMMAND_ID, atParseString };
+static const ATCommand cmdGetTemperature PROGMEM =
+  { textGetTemperature, 0, 1, AT_LINE_NONE, WISOL_COMMAND_TIMEOUT, COMMAND_SENSOR, parseTemperature };
+static const ATCommand cmdGetVoltage PROGMEM =
+  { textGetVoltage, 0, 1, AT_LINE_NONE, WISOL_COMMAND_TIMEOUT, COMMAND_SENSOR, parseVoltage };
+static const ATCommand cmdReset PROGMEM =
+  { textReset, 0, 1, AT_LINE_NONE, WISOL_COMMAND_TIMEOUT, COMMAND_OTHER, 0 };
+static const ATCommand cmdSleep PROGMEM =
+  { textSleep, 0, 1, AT_LINE_NONE, WISOL_COMMAND_TIMEOUT, COMMAND_OTHER, 0 };
+//  First command of begin(), which answers at once.  A short timeout so that a module
+//  at another UART rate is found quickly.
+static const ATCommand cmdEmulatorDisable PROGMEM =
+  { textEmulatorDisable, 0, 1, AT_LINE_NONE, COMMAND_TIMEOUT, COMMAND_OTHER, 0 };
+static const ATCommand cmdEmulatorEnable PROGMEM =
+  { textEmulatorEnable, 0, 1, AT_LINE_NONE, COMMAND_TIMEOUT, COMMAND_OTHER, 0 };
+
+const ZoneProfile *getZoneProfile(int zone) {
+  for (unsigned i = 0; i < sizeof(zoneProfiles) / sizeof(zoneProfiles[0]); i++)
+    if (zoneProfiles[i].zone == zone) return &zoneProfiles[i];
+  return 0;
+}
+
+const ZoneProfile *getZoneProfile(Country country) {
+  for (unsigned i = 0; i < sizeof(countryZones) / sizeof(countryZones[0]); i++)
+    if (countryZones[i].country == country) return getZoneProfile(countryZones[i].zone);
+  return getZoneProfile(4);  //  Rest of the world runs on RCZ4.
+}
 
 void sleep(int milliSeconds) {
 #ifdef BEAN_BEAN_BEAN_H
@@ -55,93 +147,102 @@ void sleep(int milliSeconds) {
 #endif // BEAN_BEAN_BEAN_H
 }
 
-bool Wisol::sendBuffer(const String &buffer, const int timeout,
-                       uint8_t expectedMarkerCount, String &response,
-                       uint8_t &actualMarkerCount) {
-  //  buffer contains a string of ASCII chars to be sent to the modem.
-  //  We send the buffer to the modem.  Return true if successful.
-  //  expectedMarkerCount is the number of end-of-command markers '\r' we
-  //  expect to see.  actualMarkerCount contains the actual number seen.
-  log2(F(" - Wisol.sendBuffer: "), buffer);
-  response = "";
-
-  actualMarkerCount = 0;
-  //  Start serial interface.
-  serialPort->begin(MODEM_BITS_PER_SECOND);
-  sleep(200);
-  serialPort->flush();
-  serialPort->listen();
-
-  //  Send the buffer: need to write/read char by char because of echo.
-  const char *rawBuffer = buffer.c_str();
-  //  Send buffer and read response.  Loop until timeout or we see the end of response marker.
-  unsigned long startTime = millis(); int i = 0;
-  //  Previous code for verifying that data was sent correctly.
-  //static String echoSend = "", echoReceive = "";
-  for (;;) {
-    //  If there is data to send, send it.
-    if (i < buffer.length()) {
-      //  Send the char.
-      uint8_t txChar = rawBuffer[i];
-      //echoSend.concat(toHex((char) txChar) + ' ');
-      serialPort->write(txChar);
-      sleep(10);  //  Need to wait a while because SoftwareSerial has no FIFO and may overflow.
-      i = i + 1;
-      startTime = millis();  //  Start the timer only when all data has been sent.
-    }
-    //  If timeout, quit.
-    const unsigned long currentTime = millis();
-    if (currentTime - startTime > timeout) break;
-
-    //  If data is available to receive, receive it.
-    if (serialPort->available() > 0) {
-      int rxChar = serialPort->read();
-      //  echoReceive.concat(toHex((char) rxChar) + ' ');
-      if (rxChar == -1) continue;
-      if (rxChar == END_OF_RESPONSE) {
-        if (actualMarkerCount < markerPosMax)
-          markerPos[actualMarkerCount] = response.length();  //  Remember the marker pos.
-        actualMarkerCount++;  //  Count the number of end markers.
-        if (actualMarkerCount >= expectedMarkerCount) break;  //  Seen all markers already.
-      } else {
-        // log2(F("rxChar "), rxChar);
-        response.concat(String((char) rxChar));
-      }
-    }
-  }
-  serialPort->end();
-  //  Log the actual bytes sent and received.
-  //log2(F(">> "), echoSend);
-  //  if (echoReceive.length() > 0) { log2(F("<< "), echoReceive); }
-  logBuffer(F(">> "), rawBuffer, 0, 0);
-  logBuffer(F("<< "), response.c_str(), markerPos, actualMarkerCount);
-
-  //  If we did not see the terminating '\r', something is wrong.
-  if (actualMarkerCount < expectedMarkerCount) {
-    if (response.length() == 0) {
-      log1(F(" - Wisol.sendBuffer: Error: No response"));  //  Response timeout.
-    } else {
-      log2(F(" - Wisol.sendBuffer: Error: Unknown response: "), response);
+void Wisol::beginSession() {
+  //  Start the serial interface and wait for the module.  Commands sent before
+  //  endSession() share the session instead of each opening the port again.
+  if (engine.inSession()) return;
+  wakeUp();  //  Wake the module if asleep.  The settle time below overlaps the wake up.
+  const unsigned long openTime = millis();
+  engine.beginSession();
+  if (waking) {
+    //  Wait for the rest of the wake up time.
+    const unsigned long elapsed = millis() - wakeStart;
+    if (elapsed < WISOL_WAKE_TIME) {
+      sleep(WISOL_WAKE_TIME - elapsed);
+      if (sending) timing.wake += WISOL_WAKE_TIME - elapsed;
     }
-    return false;
+    waking = false;
   }
-  log2(F(" - Wisol.sendBuffer: response: "), response);
+  if (sending) timing.settle += millis() - openTime;
+}
+
+void Wisol::wakeUp() {
+  //  Send a break to wake the module from sleep: 0x00 at 1200 bps holds the line
+  //  low for 7.5 ms.  The module is ready WISOL_WAKE_TIME after the break.
+  if (!asleep) return;
+  serialBegin(serialPort, 1200);
+  serialPort->write((uint8_t) 0);
+  if (captureHook) captureHook(captureContext, true, 0);
+  serialEnd(serialPort);
+  asleep = false;
+  waking = true;
+  wakeStart = millis();
+  energy.sleep += wakeStart - sleepStart;
+}
+
+bool Wisol::powerDown() {
+  //  Put the module to sleep until the next command.
+  if (asleep) return true;
+  if (!sendCommand(&cmdSleep)) return false;
+  asleep = true;
+  sleepStart = millis();
   return true;
 }
 
+void Wisol::setAutoSleep(bool enabled) {
+  //  Sleep after each send if enabled.
+  autoSleep = enabled;
+}
+
+void Wisol::endSend() {
+  //  Count the time spent transmitting and receiving, then sleep if enabled.
+  energy.transmit += timing.response;
+  energy.receive += timing.downlink;
+  if (autoSleep) powerDown();
+}
+
+EnergyUse Wisol::getEnergyUse() {
+  //  Return the time spent in each power state and the average current.
+  EnergyUse use = energy;
+  const unsigned long now = millis();
+  if (asleep) use.sleep += now - sleepStart;
+  const unsigned long total = now - energyStart;
+  const unsigned long busy = use.sleep + use.transmit + use.receive;
+  use.idle = total > busy ? total - busy : 0;
+  if (total > 0)
+    use.averageCurrent = (use.sleep * sleepCurrent + use.idle * idleCurrent
+      + use.transmit * (float) profile->transmitCurrent + use.receive * receiveCurrent) / total;
+  return use;
+}
+
+void Wisol::resetEnergy() {
+  energy = EnergyUse();
+  energyStart = millis();
+  if (asleep) sleepStart = energyStart;
+}
+
+void Wisol::endSession() {
+  engine.endSession();
+}
+
 bool Wisol::sendMessage(const String &payload) {
   //  Payload contains a string of hex digits, up to 24 digits / 12 bytes.
   //  We prefix with AT$SF= and send to SIGFOX.  Return true if successful.
   log2(F(" - Wisol.sendMessage: "), device + ',' + payload);
+  const unsigned long start = millis();
+  timing = SendTiming();
   if (!isReady()) return false;  //  Prevent user from sending too many messages.
+  sending = true;
   //  Exit command mode and prepare to send message.
   if (!exitCommandMode()) return false;
   //  Set the output power for the zone.
-  if (!setOutputPower()) return false;
+  if (!setOutputPower()) { endSendTiming(start); return false; }
   //  Send the data.
-  String message = String(CMD_SEND_MESSAGE) + payload + CMD_END, data;
-  if (sendBuffer(message, WISOL_COMMAND_TIMEOUT, 1, data, markers)) {  //  One '\r' marker expected ("OK\r").
-    log1(data);
+  const bool ok = sendCommand(&cmdSendMessage, 0, payload.c_str());  //  One line expected ("OK").
+  trackChannel(ok);
+  endSendTiming(start);
+  endSend();
+  if (ok) {
     lastSend = millis();
     return true;
   }
@@ -152,47 +253,73 @@ bool Wisol::sendMessageAndGetResponse(const String &payload, String &response) {
   //  Payload contains a string of hex digits, up to 24 digits / 12 bytes.
   //  We prefix with AT$SF= and send to SIGFOX.  Return response message from Sigfox in the response parameter.
   log2(F(" - Wisol.sendMessageAndGetResponse: "), device + ',' + payload);
+  if (!profile->downlink) {
+    log2(F(" - Wisol.sendMessageAndGetResponse: No downlink in zone "), profile->zone);
+    return false;
+  }
+  const unsigned long start = millis();
+  timing = SendTiming();
   if (!isReady()) return false;  //  Prevent user from sending too many messages.
+  sending = true;
   //  Exit command mode and prepare to send message.
   if (!exitCommandMode()) return false;
   //  Set the output power for the zone.
-  if (!setOutputPower()) return false;
-  //  Send the data.
-  String message = String(CMD_SEND_MESSAGE) + payload + CMD_SEND_MESSAGE_RESPONSE + CMD_END, data;
-  //  Two '\r' markers expected ("OK\r RX=...\r").
-  if (sendBuffer(message, WISOL_COMMAND_TIMEOUT, 2, data, markers)) {
-    log1(data);
+  if (!setOutputPower()) { endSendTiming(start); return false; }
+  //  Send the data.  Two lines expected ("OK", "RX=01 23 45 67 89 AB CD EF").
+  const bool ok = sendCommand(&cmdSendMessageResponse, &response, payload.c_str());
+  trackChannel(ok);
+  endSendTiming(start);
+  endSend();
+  if (ok) {
+    log2(F(" - Wisol.sendMessageAndGetResponse: response: "), response);
     lastSend = millis();
-    response = data;
-    //  Response contains OK\nRX=01 23 45 67 89 AB CD EF
-    //  Remove the prefix and spaces.
-    response.replace("OK\nRX=", "");
-    response.replace(" ", "");
     return true;
   }
   return false;
 }
 
+void Wisol::trackChannel(bool sent) {
+  //  Count down the X,Y from AT$GI? like the module does: each uplink uses a micro
+  //  channel.  If the send failed, we don't know what the module did.
+  if (!sent) { channelY = -1; return; }
+  if (channelY > 0) channelY--;
+  if (channelY == 0) channelX = 0;
+}
+
+void Wisol::endSendTiming(unsigned long start) {
+  //  Record the timing of the AT$SF command and the whole send.
+  const ATTiming &command = engine.getTiming();
+  timing.transmit = command.transmit;
+  timing.response = command.response;
+  timing.downlink = command.next;
+  timing.total = millis() - start;
+  sending = false;
+}
+
 bool Wisol::setOutputPower() {
-  //  Set the output power for the zone before sending a message.
-  switch(zone) {
-    case 1:  //  RCZ1
-    case 3:  //  RCZ3
-      if (!sendCommand(String(CMD_OUTPUT_POWER_MAX) + CMD_END, 1, data, markers)) return false;
-      break;
-    case 2:  //  RCZ2
-    case 4: {  //  RCZ4
-      if (!sendCommand(String(CMD_PRESEND) + CMD_END, 1, data, markers)) return false;
-      //  Parse the returned X,Y.
-      int x = data.charAt(0) - '0';
-      int y = data.charAt(2) - '0';
-      // log4("x,y=", String(x), ',', String(y));
-      if (x == 0 || y < 3) sendCommand(String(CMD_PRESEND2) + CMD_END, 1, data, markers);
-      break;
-    }
-    default:
-      log2(F(" - Wisol.setOutputPower: Unknown zone "), zone);
-      return false;
+  //  Run the power setup commands for the zone before sending a message.
+  unsigned long start = millis();
+  if (profile->outputPower) {  //  RCZ1, 3
+    if (!sendCommand(&cmdOutputPower, 0, profile->outputPower)) return false;
+    timing.presend = millis() - start;
+  }
+  if (!profile->channelReset) return true;
+  //  RCZ2, 4: Ask for X,Y only if we have not tracked it since the last AT$GI?.
+  if (channelY >= 0 && millis() - channelTime < WISOL_CHANNEL_TTL) skippedCommands++;
+  else {
+    int8_t channel[2];  //  Returned X,Y.
+    if (!sendCommand(&cmdPresend, channel)) return false;
+    timing.presend = millis() - start;
+    channelX = channel[0];
+    channelY = channel[1];
+    channelTime = millis();
+    // log4("x,y=", String(channelX), ',', String(channelY));
+  }
+  if (channelX == 0 || channelY < 3) {
+    start = millis();
+    sendCommand(&cmdPresend2);
+    timing.reset = millis() - start;
+    channelY = -1;  //  Ask for the new X,Y before the next send.
   }
   return true;
 }
@@ -211,27 +338,56 @@ bool Wisol::exitCommandMode() {
 
 bool Wisol::getID(String &id, String &pac) {
   //  Get the SIGFOX ID and PAC for the module.
-  if (!sendCommand(String(CMD_GET_ID) + CMD_END, 1, data, markers)) return false;
-  id = data;
+  const ATStep steps[] = { { &cmdGetID, &id, 0 }, { &cmdGetPAC, &pac, 0 } };
+  if (sendCommands(steps, 2) < 2) return false;
   device = id;
-  if (!sendCommand(String(CMD_GET_PAC) + CMD_END, 1, data, markers)) return false;
-  pac = data;
   log2(F(" - Wisol.getID: returned id="), id + ", pac=" + pac);
   return true;
 }
 
+bool Wisol::getTelemetry(float &temperature, float &voltage, String &id) {
+  //  Read the module temperature, voltage and SIGFOX ID in one serial session.
+  //  getTemperature() and getVoltage() return the cached values until the TTL expires.
+  telemetryTime = 0;
+  const ATStep steps[] = {
+    { &cmdGetTemperature, &temperature, 0 }, { &cmdGetVoltage, &voltage, 0 }, { &cmdGetID, &id, 0 } };
+  if (sendCommands(steps, 3) < 3) return false;
+  device = id;
+  cachedTemperature = temperature;
+  cachedVoltage = voltage;
+  telemetryTime = millis();
+  if (telemetryTime == 0) telemetryTime = 1;  //  0 means no cached values.
+  log4(F(" - Wisol.getTelemetry: returned "), temperature, ',', voltage);
+  return true;
+}
+
+bool Wisol::isTelemetryCached() {
+  //  Return true if the cached telemetry may be used.
+  return telemetryTTL > 0 && telemetryTime != 0 && millis() - telemetryTime < telemetryTTL;
+}
+
+void Wisol::setTelemetryTTL(unsigned long ttl) {
+  //  Set how long getTemperature() and getVoltage() may return cached values.
+  telemetryTTL = ttl;
+}
+
 bool Wisol::getTemperature(float &temperature) {
-  //  Returns the temperature of the SIGFOX module.
-  if (!sendCommand(String(CMD_GET_TEMPERATURE) + CMD_END, 1, data, markers)) return false;
-  temperature = data.toInt() / 10.0;
+  //  Returns the temperature of the SIGFOX module.  If caching is enabled, read
+  //  all the telemetry in one session and return the cached value until it expires.
+  if (isTelemetryCached()) { temperature = cachedTemperature; return true; }
+  float voltage; String id;
+  if (telemetryTTL > 0) return getTelemetry(temperature, voltage, id);
+  if (!sendCommand(&cmdGetTemperature, &temperature)) return false;
   log2(F(" - Wisol.getTemperature: returned "), temperature);
   return true;
 }
 
 bool Wisol::getVoltage(float &voltage) {
-  //  Returns the power supply voltage.
-  if (!sendCommand(String(CMD_GET_VOLTAGE) + CMD_END, 1, data, markers)) return false;
-  voltage = data.toFloat() / 1000.0;
+  //  Returns the power supply voltage, cached like getTemperature().
+  if (isTelemetryCached()) { voltage = cachedVoltage; return true; }
+  float temperature; String id;
+  if (telemetryTTL > 0) return getTelemetry(temperature, voltage, id);
+  if (!sendCommand(&cmdGetVoltage, &voltage)) return false;
   log2(F(" - Wisol.getVoltage: returned "), voltage);
   return true;
 }
@@ -285,7 +441,7 @@ bool Wisol::disableEmulator(String &result) {
   //  Set the module key to the unique SIGFOX key.  This is needed for sending
   //  to a real SIGFOX base station.
   log1(F(" - Disabling SNEK emulation mode..."));
-  if (!sendCommand(String(CMD_EMULATOR_DISABLE) + CMD_END, 1, data, markers)) return false;
+  if (!sendCommand(&cmdEmulatorDisable)) return false;
   return true;
 }
 
@@ -294,7 +450,7 @@ bool Wisol::enableEmulator(String &result) {
   //  to an emulator.
   log1(F(" - Enabling SNEK emulation mode..."));
   log1(F(" - WARNING: SNEK emulation mode will NOT work with a Sigfox network"));
-  if (!sendCommand(String(CMD_EMULATOR_ENABLE) + CMD_END, 1, data, markers)) return false;
+  if (!sendCommand(&cmdEmulatorEnable)) return false;
   return true;
 }
 
@@ -305,41 +461,23 @@ bool Wisol::getFrequency(String &result) {
   //  3: JP (RCZ3)
   //  4: SG, TW, AU, NZ (RCZ4)
   //  log1(F(" - Wisol.getFrequency: ERROR - Not implemented"));
-  result = String(zone + '0');
+  result = String(profile->zone);
   return true;
 }
 
-bool Wisol::setFrequency(int zone0, String &result) {
-  //  Get the frequency used for the SIGFOX module
+bool Wisol::setFrequency(int zone, String &result) {
+  //  Set the zone used for the SIGFOX module
   //  1: Europe (RCZ1)
   //  2: US (RCZ2)
   //  3: JP (RCZ3)
   //  4: AU/NZ (RCZ4)
-  zone = zone0;
-  switch(zone) {
-    case 1:  //  RCZ1
-      // if (!sendCommand(String(CMD_RCZ1) + CMD_END, 1, data, markers)) return false;
-      // if (!sendCommand(String(CMD_OUTPUT_POWER_MAX) + CMD_END, 1, data, markers)) return false;
-      // if (!sendCommand(String(CMD_MODULATION_ON) + CMD_END, 1, data, markers)) return false;
-      break;
-    case 2:  //  RCZ2
-      // if (!sendCommand(String(CMD_RCZ2) + CMD_END, 1, data, markers)) return false;
-      // if (!sendCommand(String(CMD_MODULATION_ON) + CMD_END, 1, data, markers)) return false;
-      break;
-    case 3:  //  RCZ3
-      // if (!sendCommand(String(CMD_RCZ3) + CMD_END, 1, data, markers)) return false;
-      // if (!sendCommand(String(CMD_OUTPUT_POWER_MAX) + CMD_END, 1, data, markers)) return false;
-      // if (!sendCommand(String(CMD_MODULATION_ON) + CMD_END, 1, data, markers)) return false;
-      break;
-    case 4:  //  RCZ4
-      // if (!sendCommand(String(CMD_RCZ4) + CMD_END, 1, data, markers)) return false;
-      // if (!sendCommand(String(CMD_MODULATION_ON) + CMD_END, 1, data, markers)) return false;
-      break;
-    default:
-      log2(F(" - Wisol.setFrequency: Unknown zone "), zone);
-      return false;
+  const ZoneProfile *zoneProfile = getZoneProfile(zone);
+  if (!zoneProfile) {
+    log2(F(" - Wisol.setFrequency: Unknown zone "), zone);
+    return false;
   }
-  // if (!sendCommand(String(CMD_MODULATION_OFF) + CMD_END, 1, data, markers)) return false;
+  profile = zoneProfile;
+  //  The module is factory set to its zone, so only the profile changes.
   result = "OK";
   return true;
 }
@@ -372,7 +510,8 @@ bool Wisol::setFrequencyJP(String &result) {
 bool Wisol::reboot(String &result) {
   //  Software reset the module.
   log1(F(" - Wisol.reboot"));
-  if (!sendCommand(String(CMD_RESET) + CMD_END, 1, data, markers)) return false;
+  channelY = -1;  //  Module may have reset X,Y.
+  if (!sendCommand(&cmdReset)) return false;
   return true;
 }
 
@@ -396,26 +535,50 @@ Wisol::Wisol(Country country0, bool useEmulator0, const String device0, bool ech
     Wisol(country0, useEmulator0, device0, echo, WISOL_RX, WISOL_TX) {}  //  Forward to constructor below.
 
 Wisol::Wisol(Country country0, bool useEmulator0, const String device0, bool echo,
-                         uint8_t rx, uint8_t tx) {
-  //  Init the module with the specified transmit and receive pins.
+                         uint8_t rx, uint8_t tx):
+    //  Init the module with the specified transmit and receive pins.
+    //  Bean+ firmware 0.6.1 can't receive serial data properly. We provide
+    //  an alternative class BeanSoftwareSerial to work around this.
+    //  For Bean, SoftwareSerial is a #define alias for BeanSoftwareSerial.
+    Wisol(country0, useEmulator0, device0, echo, SIGFOX_SERIAL_OPEN(rx, tx)) {}
+
+Wisol::Wisol(Country country0, bool useEmulator0, const String device0, bool echo,
+                         SIGFOX_SERIAL_PORT *port):
+    //  AT commands end with '\r'.  Pause after each byte because SoftwareSerial has no FIFO.
+    engine(port, MODEM_BITS_PER_SECOND, CMD_END, SIGFOX_SERIAL_PACING(10), false) {
+  //  Init the module with the specified serial port.
   //  Default to no echo.
-  zone = 4;  //  RCZ4
+  profile = getZoneProfile(country0);
+  timing = SendTiming();
+  sending = false;
+  channelX = 0;
+  channelY = -1;
+  channelTime = 0;
+  skippedCommands = 0;
+  cachedTemperature = cachedVoltage = 0;
+  telemetryTime = 0;
+  telemetryTTL = 0;  //  No caching unless the sketch asks for it.
+  autoSleep = asleep = waking = false;
+  wakeStart = sleepStart = energyStart = 0;
+  energy = EnergyUse();
   country = country0;
   useEmulator = useEmulator0;
   device = device0;
-  //  Bean+ firmware 0.6.1 can't receive serial data properly. We provide
-  //  an alternative class BeanSoftwareSerial to work around this.
-  //  For Bean, SoftwareSerial is a #define alias for BeanSoftwareSerial.
-  serialPort = new SoftwareSerial(rx, tx);
+  serialPort = port;
+  captureHook = 0;
+  captureContext = 0;
   if (echo) echoPort = &Serial;
   else echoPort = &nullPort;
   lastEchoPort = &Serial;
+  engine.setEchoPort(echoPort);
 }
 
 bool Wisol::begin() {
   //  Wait for the module to power up, configure transmission frequency.
   //  Return true if module is ready to send.
   lastSend = 0;
+  channelY = -1;  //  Ask for X,Y before the first send.
+  resetEnergy();
   for (int i = 0; i < 5; i++) {
     //  Retry 5 times.
 #ifdef BEAN_BEAN_BEAN_H
@@ -424,39 +587,30 @@ bool Wisol::begin() {
     delay(2000);
 #endif // BEAN_BEAN_BEAN_H
     String result;
+    //  Set the emulation mode and read SIGFOX ID and PAC from module, pipelined in one session.
     if (useEmulator) {
-      //  Emulation mode.
-      if (!enableEmulator(result)) continue;
-    } else {
-      //  Disable emulation mode.
-      if (!disableEmulator(result)) continue;
-    }
+      log1(F(" - Enabling SNEK emulation mode..."));
+      log1(F(" - WARNING: SNEK emulation mode will NOT work with a Sigfox network"));
+    } else log1(F(" - Disabling SNEK emulation mode..."));
     //  TODO: Check whether emulator is used for transmission.
     //  log1(F(" - Checking emulation mode (expecting 0)...")); int emulator = 0;
     //  if (!getEmulator(emulator)) continue;
-
-    //  Read SIGFOX ID and PAC from module.
     log1(F(" - Getting SIGFOX ID..."));  String id, pac;
-    if (!getID(id, pac)) continue;
-    echoPort->print(F(" - SIGFOX ID = "));  Serial.println(id);
-    echoPort->print(F(" - PAC = "));  Serial.println(pac);
+    const ATStep steps[] = {
+      { useEmulator ? &cmdEmulatorEnable : &cmdEmulatorDisable, 0, 0 },
+      { &cmdGetID, &id, 0 }, { &cmdGetPAC, &pac, 0 } };
+    const uint8_t done = sendCommands(steps, 3);
+    if (done == 0) detectBitsPerSecond();  //  No response at all: the module may use another UART rate.
+    if (done < 3) continue;
+    device = id;
+    echoPort->print(F(" - SIGFOX ID = "));  echoPort->println(id);
+    echoPort->print(F(" - PAC = "));  echoPort->println(pac);
 
     //  Set the frequency of SIGFOX module.
     // log1(F(" - Setting frequency for country "));
     // echoPort->write((uint8_t) (country / 8));
     // echoPort->write((uint8_t) (country % 8));
-    if (country == COUNTRY_JP) {  //  Set Japan frequency (RCZ3).
-      if (!setFrequencyJP(result)) continue;
-    } else if (country == COUNTRY_US) {  //  Set US frequency (RCZ2).
-      if (!setFrequencyUS(result)) continue;
-    } else if (
-      country == COUNTRY_FR
-      || country == COUNTRY_OM
-      || country == COUNTRY_SA) {  //  Set France frequency (RCZ1).
-      if (!setFrequencyETSI(result)) continue;
-    } else { //  Rest of the world runs on RCZ4.
-      if (!setFrequencySG(result)) continue;
-    }
+    if (!setFrequency(profile->zone, result)) continue;
     log2(F(" - Set frequency result = "), result);
 
     //  Get and display the frequency used by the SIGFOX module.  Should return 3 for RCZ4 (SG/TW).
@@ -468,15 +622,37 @@ bool Wisol::begin() {
   return false;  //  Failed to init module.
 }
 
-bool Wisol::sendCommand(const String &cmd, uint8_t expectedMarkerCount,
-                              String &result, uint8_t &actualMarkerCount) {
-  //  We send the command string in cmd to SIGFOX.  Return true if successful.
-  //  Enter command mode.
+bool Wisol::detectBitsPerSecond() {
+  //  Find the UART rate of the module.  The WSSFM10R has no command to change the
+  //  rate, so we follow the rate that the module was configured with.
+  wakeUp();
+  return engine.detectBitsPerSecond(&cmdAT);
+}
+
+bool Wisol::sendCommand(const ATCommand *command, void *result, const char *argument) {
+  //  Run the AT command with the argument and parse the response into result.
+  //  Wakes the module if asleep.  Return true if successful.
   if (!enterCommandMode()) return false;
-  if (!sendBuffer(cmd, WISOL_COMMAND_TIMEOUT, expectedMarkerCount,
-                  data, actualMarkerCount)) return false;
-  result = data;
-  return true;
+  const bool ownSession = !engine.inSession();
+  beginSession();
+  const bool ok = engine.run(command, result, argument);
+  if (ownSession) endSession();
+  if (sending) {
+    timing.bytesSent += engine.getTiming().bytesSent;
+    timing.bytesReceived += engine.getTiming().bytesReceived;
+  }
+  return ok;
+}
+
+uint8_t Wisol::sendCommands(const ATStep *steps, uint8_t count) {
+  //  Run the AT commands pipelined in one session.  Wakes the module if asleep.
+  //  Return the number of commands that succeeded.
+  if (!enterCommandMode()) return 0;
+  const bool ownSession = !engine.inSession();
+  beginSession();
+  const uint8_t done = engine.runAll(steps, count);
+  if (ownSession) endSession();
+  return done;
 }
 
 bool Wisol::sendString(const String &str) {
@@ -530,18 +706,28 @@ bool Wisol::isReady()
 void Wisol::echoOn() {
   //  Echo commands and responses to the echo port.
   echoPort = lastEchoPort;
+  engine.setEchoPort(echoPort);
   log1(F(" - Wisol.echoOn"));
 }
 
 void Wisol::echoOff() {
   //  Stop echoing commands and responses to the echo port.
   lastEchoPort = echoPort; echoPort = &nullPort;
+  engine.setEchoPort(echoPort);
+}
+
+void Wisol::setCaptureHook(SerialCaptureHook hook, void *context) {
+  //  Capture the bytes sent to and received from the module.
+  captureHook = hook;
+  captureContext = context;
+  engine.setCaptureHook(hook, context);
 }
 
 void Wisol::setEchoPort(Print *port) {
   //  Set the port for sending echo output.
   lastEchoPort = echoPort;
   echoPort = port;
+  engine.setEchoPort(echoPort);
 }
 
 void Wisol::echo(const String &msg) {
@@ -640,41 +826,3 @@ String Wisol::toHex(char *c, int length) {
   }
   return bytes;
 }
-
-uint8_t Wisol::hexDigitToDecimal(char ch) {
-  //  Convert 0..9, a..f, A..F to decimal.
-  if (ch >= '0' && ch <= '9') return (uint8_t) ch - '0';
-  if (ch >= 'a' && ch <= 'z') return (uint8_t) ch - 'a' + 10;
-  if (ch >= 'A' && ch <= 'Z') return (uint8_t) ch - 'A' + 10;
-  log2(F(" - Wisol.hexDigitToDecimal: Error: Invalid hex digit "), ch);
-  return 0;
-}
-
-//  Convert nibble to hex digit.
-static const char nibbleToHex[] = "0123456789abcdef";
-
-void Wisol::logBuffer(const __FlashStringHelper *prefix, const char *buffer,
-                            uint8_t *markerPos, uint8_t markerCount) {
-  //  Log the send/receive buffer for debugging.  markerPos is an array of positions in buffer
-  //  where the '>' marker was seen and removed.
-  echoPort->print(prefix);
-  int m = 0, i = 0;
-  for (i = 0; i < strlen(buffer); i = i + 2) {
-    if (m < markerCount && markerPos[m] == i) {
-      echoPort->print("0x");
-      echoPort->write((uint8_t) nibbleToHex[END_OF_RESPONSE / 16]);
-      echoPort->write((uint8_t) nibbleToHex[END_OF_RESPONSE % 16]);
-      m++;
-    }
-    echoPort->write((uint8_t) buffer[i]);
-    echoPort->write((uint8_t) buffer[i + 1]);
-  }
-  if (m < markerCount && markerPos[m] == i) {
-    echoPort->print("0x");
-    echoPort->write((uint8_t) nibbleToHex[END_OF_RESPONSE / 16]);
-    echoPort->write((uint8_t) nibbleToHex[END_OF_RESPONSE % 16]);
-    m++;
-  }
-  echoPort->write('\n');
-}
-
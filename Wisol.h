@@ -12,7 +12,8 @@
   #ifdef CLION
     #include <src/SoftwareSerial.h>
   #else  //  CLION
-    #ifndef BEAN_BEAN_BEAN_H
+    #if !defined(BEAN_BEAN_BEAN_H) && (!defined(SIGFOX_SERIAL_PORT) || defined(SIGFOX_SERIAL_SOFTWARE))
+      //  Not needed for a hardware UART, see SerialPort.h.
       //  Bean+ firmware 0.6.1 can't receive serial data properly. We provide
       //  an alternative class BeanSoftwareSerial to work around this.
       //  See SIGFOX.h.
@@ -23,9 +24,76 @@
 #else  //  ARDUINO
 #endif  //  ARDUINO
 
+#include "SerialPort.h"
+#include "ATEngine.h"
+
 const uint8_t WISOL_TX = 4;  //  Transmit port for For UnaBiz / Wisol Dev Kit
 const uint8_t WISOL_RX = 5;  //  Receive port for UnaBiz / Wisol Dev Kit
 const unsigned int WISOL_COMMAND_TIMEOUT = 60000;  //  Wait up to 60 seconds for response from SIGFOX module.  Includes downlink response.
+const unsigned long WISOL_TELEMETRY_TTL = 60000;  //  Suggested setTelemetryTTL() for sketches that read the telemetry more than once a minute.
+const unsigned long WISOL_WAKE_TIME = 100;  //  Milliseconds for the module to wake up from sleep after a break.
+const unsigned long WISOL_CHANNEL_TTL = 3600000;  //  For RCZ2, 4: Ask the module for X,Y again after 1 hour, in case it changed on its own.
+
+//  AT commands for the Wisol module.  Also used by programs that drive many modules
+//  without the Wisol class, e.g. test/gatewayd.cpp.
+#define CMD_AT "AT"  //  Check that the module responds, e.g. to detect the UART rate.
+#define CMD_OUTPUT_POWER_MAX "ATS302=15"  //  For RCZ1: Set output power to maximum power level.
+#define CMD_PRESEND "AT$GI?"  //  For RCZ2, 4: Send this command before sending messages.  Returns X,Y.
+#define CMD_PRESEND2 "AT$RC"  //  For RCZ2, 4: Send this command if presend returns X=0 or Y<3.
+#define CMD_SEND_MESSAGE "AT$SF="  //  Prefix to send a message to SIGFOX cloud.
+#define CMD_SEND_MESSAGE_RESPONSE ",1"  //  Expect downlink response from SIGFOX.
+#define CMD_GET_ID "AT$I=10"  //  Get SIGFOX device ID.
+#define CMD_GET_PAC "AT$I=11"  //  Get SIGFOX device PAC, used for registering the device.
+#define CMD_GET_TEMPERATURE "AT$T?"  //  Get the module temperature.
+#define CMD_GET_VOLTAGE "AT$V?"  //  Get the module voltage.
+#define CMD_RESET "AT$P=0"  //  Software reset.
+#define CMD_SLEEP "AT$P=1"  //  Switch to sleep mode : consumption is < 1.5uA.  Woken by a break on the UART.
+#define CMD_END "\r"
+#define CMD_RCZ1 "AT$IF=868130000"  //  EU / RCZ1 Frequency
+#define CMD_RCZ2 "AT$IF=902200000"  //  US / RCZ2 Frequency
+#define CMD_RCZ3 "AT$IF=902080000"  //  JP / RCZ3 Frequency
+#define CMD_RCZ4 "AT$IF=920800000"  //  RCZ4 Frequency
+#define CMD_MODULATION_ON "AT$CB=-1,1"  //  Modulation wave on.
+#define CMD_MODULATION_OFF "AT$CB=-1,0"  //  Modulation wave off.
+#define CMD_EMULATOR_DISABLE "ATS410=0"  //  Device will only talk to Sigfox network.
+#define CMD_EMULATOR_ENABLE "ATS410=1"  //  Device will only talk to SNEK emulator.
+
+//  Settings for each SIGFOX Radio Configuration Zone.  The transceiver looks up the
+//  profile for its country once, when constructed.  Adding a zone (e.g. RCZ5, 6)
+//  only needs a new row in the table in Wisol.cpp.
+struct ZoneProfile {
+  uint8_t zone;  //  RCZ number.
+  const char *outputPower;  //  Command to set the output power before each send, or 0.
+  bool channelReset;  //  Check X,Y with AT$GI? and reset with AT$RC before each send (FCC frequency hopping).
+  bool downlink;  //  True if downlink is supported.
+  uint16_t transmitCurrent;  //  Approximate supply current (mA) while transmitting.
+};
+const ZoneProfile *getZoneProfile(int zone);  //  Return the profile for the RCZ, or 0 if unknown.
+const ZoneProfile *getZoneProfile(Country country);  //  Return the profile for the country's RCZ.
+
+//  Timing of the last sendMessage() or sendMessageAndGetResponse() in milliseconds,
+//  0 for steps that were skipped.  Cheap to keep: a few millis() calls per command.
+//  The fields that include a response wait are 32 bits since a downlink may take
+//  over a minute.
+struct SendTiming {
+  uint16_t settle;  //  Opening the UART and waiting for the module, for all commands.
+  uint32_t presend;  //  AT$GI? (RCZ2, 4) or ATS302 (RCZ1, 3) round trip.
+  uint16_t reset;  //  AT$RC round trip, if sent.
+  uint16_t transmit;  //  Writing the AT$SF command to the module.
+  uint32_t response;  //  From the end of AT$SF until OK.
+  uint32_t downlink;  //  From OK until the downlink, for sendMessageAndGetResponse().
+  uint32_t total;  //  Whole send.
+  uint16_t bytesSent;  //  Bytes written to the module for the whole send.
+  uint16_t bytesReceived;  //  Bytes received from the module for the whole send.
+  uint16_t wake;  //  Waiting for the module to wake up from sleep, beyond the settle time.
+};
+
+//  Milliseconds the module spent in each power state since resetEnergy().  Sleep
+//  draws about 1.5 uA, idle 0.5 mA, transmit and receive are from AT$SF timing.
+struct EnergyUse {
+  unsigned long sleep, idle, transmit, receive;
+  float averageCurrent;  //  Estimated average supply current in mA.
+};
 
 class Wisol
 {
@@ -33,12 +101,20 @@ public:
   Wisol(Country country, bool useEmulator, const String device, bool echo);
   Wisol(Country country, bool useEmulator, const String device, bool echo,
               uint8_t rx, uint8_t tx);
+  Wisol(Country country, bool useEmulator, const String device, bool echo,
+              SIGFOX_SERIAL_PORT *port);  //  Use this port, e.g. a Linux serial device.
   bool begin();
   void echoOn();  //  Turn on send/receive echo.
   void echoOff();  //  Turn off send/receive echo.
   void setEchoPort(Print *port);  //  Set the port for sending echo output.
+  void setCaptureHook(SerialCaptureHook hook, void *context);  //  Capture the bytes sent and received.  0 to stop.
   void echo(const String &msg);  //  Echo the debug message.
   bool isReady();
+  const SendTiming &getSendTiming() const { return timing; }  //  Timing of the last send.
+  LatencyHistogram &getLatency() { return engine.getLatency(); }  //  Response latency of all commands, to dump or pack.
+  bool detectBitsPerSecond();  //  Find the UART rate of the module.  Done by begin() if the module doesn't respond.
+  unsigned long getBitsPerSecond() const { return engine.getBitsPerSecond(); }  //  UART rate of the module.
+  unsigned long getSkippedCommands() const { return skippedCommands; }  //  Round trips saved by tracking X,Y.
   bool sendMessage(const String &payload);  //  Send the payload of hex digits to the network, max 12 bytes.
   bool sendMessageAndGetResponse(const String &payload, String &response);  //  Send the payload of hex digits to the network and get response.
   bool sendString(const String &str);  //  Sending a text string, max 12 characters allowed.
@@ -65,6 +141,16 @@ public:
   bool writeSettings(String &result); //  Write frequency and other settings to flash memory of the module.
   bool reboot(String &result);  //  Reboot the SIGFOX module.
   bool getTemperature(float &temperature);
+  bool getTelemetry(float &temperature, float &voltage, String &id);  //  Read all three in one serial session.
+  void setTelemetryTTL(unsigned long ttl);  //  Milliseconds to cache the telemetry, 0 (the default) to disable.
+  //  Power management.  With auto sleep, the module sleeps after each send and is
+  //  woken at the next command.  Call wakeUp() before reading sensors to overlap
+  //  the wake up with the sampling.
+  void setAutoSleep(bool enabled);
+  bool powerDown();  //  Put the module to sleep now.
+  void wakeUp();  //  Start waking the module if asleep.  Commands wait until it is awake.
+  EnergyUse getEnergyUse();
+  void resetEnergy();
   bool getID(String &id, String &pac);  //  Get the SIGFOX ID and PAC for the module.
   bool getVoltage(float &voltage);
   bool getHardware(String &hardware);
@@ -84,24 +170,44 @@ public:
   String toHex(char *c, int length);
 
 private:
-  bool sendCommand(const String &cmd, uint8_t expectedMarkers,
-                   String &result, uint8_t &actualMarkers);
-  bool sendBuffer(const String &buffer, int timeout, uint8_t expectedMarkers,
-                  String &dataOut, uint8_t &actualMarkers);
+  bool sendCommand(const ATCommand *command, void *result = 0, const char *argument = 0);
+  uint8_t sendCommands(const ATStep *steps, uint8_t count);
+  void beginSession();
+  void endSession();
+  bool isTelemetryCached();
+  void endSend();
   bool setFrequency(int zone, String &result);
-  uint8_t hexDigitToDecimal(char ch);
-  void logBuffer(const __FlashStringHelper *prefix, const char *buffer,
-                 uint8_t markerPos[], uint8_t markerCount);
 
-  int zone;  //  1 to 4 representing SIGFOX frequencies RCZ 1 to 4.
+  const ZoneProfile *profile;  //  Settings for the SIGFOX frequencies RCZ 1 to 4.
   Country country;   //  Country to be set for SIGFOX transmission frequencies.
   bool useEmulator;  //  Set to true if using UnaBiz Emulator.
   String device;  //  Name of device if using UnaBiz Emulator.
-  SoftwareSerial *serialPort;  //  Serial port for the SIGFOX module.
+  ATEngine engine;  //  Sends the AT commands and parses the responses.
+  SIGFOX_SERIAL_PORT *serialPort;  //  Serial port for the SIGFOX module.
   Print *echoPort;  //  Port for sending echo output.  Defaults to Serial.
   Print *lastEchoPort;  //  Last port used for sending echo output.
   unsigned long lastSend;  //  Timestamp of last send.
+  void endSendTiming(unsigned long start);
+  SendTiming timing;  //  Timing of the last send.
+  bool sending;  //  True while sending, when commands add to the timing.
+  SerialCaptureHook captureHook;  //  Called for each byte sent and received, if set.
+  void *captureContext;
+  float cachedTemperature, cachedVoltage;  //  Last telemetry read from the module.
+  unsigned long telemetryTime;  //  When the telemetry was read, 0 if never.
+  unsigned long telemetryTTL;  //  How long the telemetry may be cached.
+  bool autoSleep;  //  True if the module should sleep after each send.
+  bool asleep;  //  True after AT$P=1 until woken.
+  bool waking;  //  True after the wake up break until the module is awake.
+  unsigned long wakeStart;  //  When the break was sent.
+  unsigned long energyStart, sleepStart;  //  When energy accounting started, when the module fell asleep.
+  EnergyUse energy;  //  Power state times, not counting the current sleep.
   bool setOutputPower();
+  void trackChannel(bool sent);
+  //  For RCZ2, 4: X,Y channel state last returned by AT$GI?, counted down locally
+  //  for each uplink.  channelY is -1 if unknown.
+  int8_t channelX, channelY;
+  unsigned long channelTime;  //  When AT$GI? was last sent.
+  unsigned long skippedCommands;  //  Number of AT$GI? skipped because X,Y was known.
 };
 
 #endif // UNABIZ_ARDUINO_WISOL_H
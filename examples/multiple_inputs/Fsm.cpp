@@ -16,119 +16,62 @@
 #include "Fsm.h"
 
 
-State::State(void (*on_enter)(), void (*on_state)(), void (*on_exit)())
-: on_enter(on_enter),
-  on_state(on_state),
-  on_exit(on_exit)
+void Fsm::init(const State* initial_state, const Transition* transitions,
+               const uint8_t* table, const uint8_t* timed_table,
+               uint8_t num_states, uint8_t num_events,
+               const TimedTransition* timed_transitions)
 {
+  m_current_state = initial_state;
+  m_transitions = transitions;
+  m_table = table;
+  m_num_states = num_states;
+  m_num_events = num_events;
+  m_timed_transitions = timed_transitions;
+  m_timed_table = timed_table;
+  m_next_timed = NULL;
+  m_state_start = 0;
+  m_initialized = false;
 }
 
 
-Fsm::Fsm(State* initial_state)
-: m_current_state(initial_state),
-  m_transitions(NULL),
-  m_num_transitions(0),
-  m_num_timed_transitions(0),
-  m_initialized(false)
-{
-}
-
-
-Fsm::~Fsm()
-{
-  free(m_transitions);
-  free(m_timed_transitions);
-  m_transitions = NULL;
-  m_timed_transitions = NULL;
-}
-
-
-void Fsm::add_transition(State* state_from, State* state_to, int event,
-                         void (*on_transition)())
+void Fsm::trigger(int event)
 {
-  if (state_from == NULL || state_to == NULL)
+  if (!m_initialized || event < 0 || event >= m_num_events ||
+      m_current_state->id >= m_num_states)
     return;
 
-  Transition transition = Fsm::create_transition(state_from, state_to, event,
-                                               on_transition);
-  m_transitions = (Transition*) realloc(m_transitions, (m_num_transitions + 1)
-                                                       * sizeof(Transition));
-  m_transitions[m_num_transitions] = transition;
-  m_num_transitions++;
-}
-
-
-void Fsm::add_timed_transition(State* state_from, State* state_to,
-                               unsigned long interval, void (*on_transition)())
-{
-  if (state_from == NULL || state_to == NULL)
+  // Look up the transition for the current state and given event.
+  uint8_t row = m_table[m_current_state->id * m_num_events + event];
+  if (row == FSM_NO_TRANSITION)
     return;
 
-  Transition transition = Fsm::create_transition(state_from, state_to, 0,
-                                                 on_transition);
-
-  TimedTransition timed_transition;
-  timed_transition.transition = transition;
-  timed_transition.start = 0;
-  timed_transition.interval = interval;
-
-  m_timed_transitions = (TimedTransition*) realloc(
-      m_timed_transitions, (m_num_timed_transitions + 1) * sizeof(TimedTransition));
-  m_timed_transitions[m_num_timed_transitions] = timed_transition;
-  m_num_timed_transitions++;
+  const Transition* transition = &m_transitions[row];
+  Fsm::make_transition(transition->state_from, transition->state_to,
+                       transition->on_transition);
 }
 
-
-Fsm::Transition Fsm::create_transition(State* state_from, State* state_to,
-                                       int event, void (*on_transition)())
+void Fsm::check_timed_transitions()
 {
-  Transition t;
-  t.state_from = state_from;
-  t.state_to = state_to;
-  t.event = event;
-  t.on_transition = on_transition;
-
-  return t;
-}
+  if (m_next_timed == NULL)
+    return;
 
-void Fsm::trigger(int event)
-{
-  if (m_initialized)
-  {
-    // Find the transition with the current state and given event.
-    for (int i = 0; i < m_num_transitions; ++i)
-    {
-      if (m_transitions[i].state_from == m_current_state &&
-          m_transitions[i].event == event)
-      {
-        Fsm::make_transition(&(m_transitions[i]));
-        return;
-      }
-    }
-  }
+  if (millis() - m_state_start >= m_next_timed->interval)
+    Fsm::make_transition(m_next_timed->state_from, m_next_timed->state_to,
+                         m_next_timed->on_transition);
 }
 
-void Fsm::check_timed_transitions()
+unsigned long Fsm::nextDeadline() const
 {
-  for (int i = 0; i < m_num_timed_transitions; ++i)
-  {
-    TimedTransition* transition = &m_timed_transitions[i];
-    if (transition->transition.state_from == m_current_state)
-    {
-      if (transition->start == 0)
-      {
-        transition->start = millis();
-      }
-      else{
-        unsigned long now = millis();
-        if (now - transition->start >= transition->interval)
-        {
-          Fsm::make_transition(&(transition->transition));
-          transition->start = 0;
-        }
-      }
-    }
-  }
+  // Before the first run the machine must be run to enter the first state.
+  if (!m_initialized)
+    return 0;
+  if (m_next_timed == NULL)
+    return FSM_NO_DEADLINE;
+
+  unsigned long elapsed = millis() - m_state_start;
+  if (elapsed >= m_next_timed->interval)
+    return 0;
+  return m_next_timed->interval - elapsed;
 }
 
 void Fsm::run_machine()
@@ -137,6 +80,7 @@ void Fsm::run_machine()
   if (!m_initialized)
   {
     m_initialized = true;
+    enter_state(m_current_state);
     if (m_current_state->on_enter != NULL)
       m_current_state->on_enter();
   }
@@ -147,28 +91,31 @@ void Fsm::run_machine()
   Fsm::check_timed_transitions();
 }
 
-void Fsm::make_transition(Transition* transition)
+void Fsm::enter_state(const State* state)
+{
+  // All timed transitions from the state count from now, so only the one
+  // with the shortest interval, looked up in the table, can fire.
+  m_current_state = state;
+  m_state_start = millis();
+  m_next_timed = NULL;
+  if (m_timed_transitions != NULL && state->id < m_num_states &&
+      m_timed_table[state->id] != FSM_NO_TRANSITION)
+    m_next_timed = &m_timed_transitions[m_timed_table[state->id]];
+}
+
+void Fsm::make_transition(const State* state_from, const State* state_to,
+                          void (*on_transition)())
 {
  
   // Execute the handlers in the correct order.
-  if (transition->state_from->on_exit != NULL)
-    transition->state_from->on_exit();
+  if (state_from->on_exit != NULL)
+    state_from->on_exit();
 
-  if (transition->on_transition != NULL)
-    transition->on_transition();
+  if (on_transition != NULL)
+    on_transition();
 
-  if (transition->state_to->on_enter != NULL)
-    transition->state_to->on_enter();
+  if (state_to->on_enter != NULL)
+    state_to->on_enter();
   
-  m_current_state = transition->state_to;
-
-  //Initialice all timed transitions from m_current_state
-  unsigned long now = millis();
-  for (int i = 0; i < m_num_timed_transitions; ++i)
-  {
-    TimedTransition* ttransition = &m_timed_transitions[i];
-    if (ttransition->transition.state_from == m_current_state)
-      ttransition->start = now;
-  }
-
+  enter_state(state_to);
 }
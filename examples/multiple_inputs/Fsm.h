@@ -26,58 +26,244 @@
 
 struct State
 {
-  State(void (*on_enter)(), void (*on_state)(), void (*on_exit)());
+  constexpr State(uint8_t id, void (*on_enter)(), void (*on_state)(),
+                  void (*on_exit)())
+  : id(id), on_enter(on_enter), on_state(on_state), on_exit(on_exit)
+  {
+  }
+  uint8_t id;  // Number of the state in its Fsm, from 0.
   void (*on_enter)();
   void (*on_state)();
   void (*on_exit)();
 };
 
 
-class Fsm
+// One row of the transition table, as declared by the sketch.  The event is
+// a number from 0 to the event count of the table - 1.
+struct Transition
 {
-public:
-  Fsm(State* initial_state);
-  ~Fsm();
+  const State* state_from;
+  const State* state_to;
+  int event;
+  void (*on_transition)();
+};
+
+
+struct TimedTransition
+{
+  const State* state_from;
+  const State* state_to;
+  unsigned long interval;
+  void (*on_transition)();
+};
+
+
+static const uint8_t FSM_NO_TRANSITION = 0xff;
+static const unsigned long FSM_NO_DEADLINE = 0xffffffffUL;
+
+
+// Dispatch table built at compile time by fsm_table(), with the rows it was
+// built from: for each state and event, the row of the transition, or
+// FSM_NO_TRANSITION.  For each state, the timed transition with the shortest
+// interval, which is the only one that can fire since they all start when
+// the state is entered.
+template <uint8_t STATES, uint8_t EVENTS>
+struct FsmTable
+{
+  const Transition* transitions;
+  const TimedTransition* timed_transitions;  // NULL if none.
+  uint8_t row[STATES * EVENTS];
+  uint8_t timed[STATES];
+};
+
+
+namespace fsm_detail
+{
+  template <unsigned... I> struct Indices {};
+  template <unsigned N, unsigned... I>
+  struct MakeIndices : MakeIndices<N - 1, N - 1, I...> {};
+  template <unsigned... I>
+  struct MakeIndices<0, I...> { typedef Indices<I...> type; };
+
+  // First row for the state and event, from row i onwards.
+  template <size_t N>
+  constexpr uint8_t find(const Transition (&rows)[N], unsigned state,
+                         int event, size_t i)
+  {
+    return i >= N ? FSM_NO_TRANSITION
+         : (rows[i].state_from->id == state && rows[i].event == event) ? i
+         : find(rows, state, event, i + 1);
+  }
+
+  // Timed row with the shortest interval for the state, from row i onwards.
+  template <size_t N>
+  constexpr uint8_t find_timed(const TimedTransition (&rows)[N],
+                               unsigned state, size_t i, uint8_t best)
+  {
+    return i >= N ? best
+         : find_timed(rows, state, i + 1,
+                      (rows[i].state_from->id == state &&
+                       (best == FSM_NO_TRANSITION ||
+                        rows[i].interval < rows[best].interval)) ? i : best);
+  }
+
+  constexpr uint8_t no_timed(unsigned)
+  {
+    return FSM_NO_TRANSITION;
+  }
+
+  // True if no state in the rows, from row i onwards, has the same number as
+  // the given state.  Otherwise trigger() would dispatch on the other state's
+  // rows.
+  template <typename Row, size_t N>
+  constexpr bool id_unique(const State* state, const Row (&rows)[N], size_t i)
+  {
+    return i >= N ||
+           ((rows[i].state_from == state || rows[i].state_from->id != state->id) &&
+            (rows[i].state_to == state || rows[i].state_to->id != state->id) &&
+            id_unique(state, rows, i + 1));
+  }
 
-  void add_transition(State* state_from, State* state_to, int event,
-                      void (*on_transition)());
+  // True if the states and events of the rows, from row i onwards, fit in
+  // the table and each state number names one state.  Otherwise the row
+  // would be left out of the table, or run for another state, silently.
+  template <uint8_t STATES, uint8_t EVENTS, size_t N>
+  constexpr bool rows_valid(const Transition (&rows)[N], size_t i)
+  {
+    return i >= N ||
+           (rows[i].event >= 0 && rows[i].event < EVENTS &&
+            rows[i].state_from->id < STATES && rows[i].state_to->id < STATES &&
+            id_unique(rows[i].state_from, rows, i + 1) &&
+            id_unique(rows[i].state_to, rows, i) &&
+            rows_valid<STATES, EVENTS>(rows, i + 1));
+  }
+
+  // Same for the timed rows, whose states are also checked against the
+  // transition rows.
+  template <uint8_t STATES, size_t TIMED, size_t N>
+  constexpr bool timed_rows_valid(const TimedTransition (&timed)[TIMED],
+                                  const Transition (&rows)[N], size_t i)
+  {
+    return i >= TIMED ||
+           (timed[i].state_from->id < STATES && timed[i].state_to->id < STATES &&
+            id_unique(timed[i].state_from, timed, i + 1) &&
+            id_unique(timed[i].state_to, timed, i) &&
+            id_unique(timed[i].state_from, rows, 0) &&
+            id_unique(timed[i].state_to, rows, 0) &&
+            timed_rows_valid<STATES>(timed, rows, i + 1));
+  }
+
+  // Never defined.  fsm_table() calls it for a row with a state or event
+  // out of range, or for two states with the same number, which is not a
+  // constant expression, so the build fails.
+  void invalid_transition_row();
+
+  template <typename T>
+  constexpr T check(bool valid, T table)
+  {
+    return valid ? table : (invalid_transition_row(), table);
+  }
+
+  template <uint8_t STATES, uint8_t EVENTS, size_t N, unsigned... I,
+            unsigned... S>
+  constexpr FsmTable<STATES, EVENTS> build(const Transition (&rows)[N],
+                                           Indices<I...>, Indices<S...>)
+  {
+    return FsmTable<STATES, EVENTS>{ rows, NULL,
+                                     { find(rows, I / EVENTS, I % EVENTS, 0)... },
+                                     { no_timed(S)... } };
+  }
+
+  template <uint8_t STATES, uint8_t EVENTS, size_t N, size_t TIMED,
+            unsigned... I, unsigned... S>
+  constexpr FsmTable<STATES, EVENTS> build(const Transition (&rows)[N],
+                                           const TimedTransition (&timed)[TIMED],
+                                           Indices<I...>, Indices<S...>)
+  {
+    return FsmTable<STATES, EVENTS>{ rows, timed,
+                                     { find(rows, I / EVENTS, I % EVENTS, 0)... },
+                                     { find_timed(timed, S, 0, FSM_NO_TRANSITION)... } };
+  }
+}
+
+
+// Build the dispatch table from constexpr transition rows, e.g.
+//   constexpr FsmTable<2, 3> table = fsm_table<2, 3>(rows);
+// A row with a state number or event out of range, or two states with the
+// same number, fails the build.
+template <uint8_t STATES, uint8_t EVENTS, size_t N>
+constexpr FsmTable<STATES, EVENTS> fsm_table(const Transition (&rows)[N])
+{
+  static_assert(N < FSM_NO_TRANSITION, "Too many transitions");
+  return fsm_detail::check(
+      fsm_detail::rows_valid<STATES, EVENTS>(rows, 0),
+      fsm_detail::build<STATES, EVENTS>(
+          rows, typename fsm_detail::MakeIndices<STATES * EVENTS>::type(),
+          typename fsm_detail::MakeIndices<STATES>::type()));
+}
 
-  void add_timed_transition(State* state_from, State* state_to,
-                            unsigned long interval, void (*on_transition)());
+
+// Same with timed transition rows, e.g.
+//   constexpr FsmTable<2, 3> table = fsm_table<2, 3>(rows, timed_rows);
+template <uint8_t STATES, uint8_t EVENTS, size_t N, size_t TIMED>
+constexpr FsmTable<STATES, EVENTS> fsm_table(const Transition (&rows)[N],
+                                             const TimedTransition (&timed)[TIMED])
+{
+  static_assert(N < FSM_NO_TRANSITION && TIMED < FSM_NO_TRANSITION,
+                "Too many transitions");
+  return fsm_detail::check(
+      fsm_detail::rows_valid<STATES, EVENTS>(rows, 0) &&
+          fsm_detail::timed_rows_valid<STATES>(timed, rows, 0),
+      fsm_detail::build<STATES, EVENTS>(
+          rows, timed, typename fsm_detail::MakeIndices<STATES * EVENTS>::type(),
+          typename fsm_detail::MakeIndices<STATES>::type()));
+}
+
+
+class Fsm
+{
+public:
+  // The table and its rows are not copied, so declare them with static
+  // storage.
+  template <uint8_t STATES, uint8_t EVENTS>
+  Fsm(const State* initial_state, const FsmTable<STATES, EVENTS>& table)
+  {
+    init(initial_state, table.transitions, table.row, table.timed, STATES,
+         EVENTS, table.timed_transitions);
+  }
 
   void check_timed_transitions();
 
+  // Milliseconds until the next timed transition is due, 0 if it is due now,
+  // or FSM_NO_DEADLINE if the current state has no timed transition.  The
+  // sketch may sleep this long between calls to run_machine().
+  unsigned long nextDeadline() const;
+
   void trigger(int event);
   void run_machine();
 
 private:
-  struct Transition
-  {
-    State* state_from;
-    State* state_to;
-    int event;
-    void (*on_transition)();
-
-  };
-  struct TimedTransition
-  {
-    Transition transition;
-    unsigned long start;
-    unsigned long interval;
-  };
+  void init(const State* initial_state, const Transition* transitions,
+            const uint8_t* table, const uint8_t* timed_table,
+            uint8_t num_states, uint8_t num_events,
+            const TimedTransition* timed_transitions);
 
-  static Transition create_transition(State* state_from, State* state_to,
-                                      int event, void (*on_transition)());
+  void enter_state(const State* state);
 
-  void make_transition(Transition* transition);
+  void make_transition(const State* state_from, const State* state_to,
+                       void (*on_transition)());
 
 private:
-  State* m_current_state;
-  Transition* m_transitions;
-  int m_num_transitions;
+  const State* m_current_state;
+  const Transition* m_transitions;
+  const uint8_t* m_table;
+  uint8_t m_num_states;
+  uint8_t m_num_events;
 
-  TimedTransition* m_timed_transitions;
-  int m_num_timed_transitions;
+  const TimedTransition* m_timed_transitions;
+  const uint8_t* m_timed_table;
+  const TimedTransition* m_next_timed;  // Next to fire in this state, or NULL.
+  unsigned long m_state_start;  // When the current state was entered.
   bool m_initialized;
 };
 
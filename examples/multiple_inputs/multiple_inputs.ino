@@ -53,10 +53,12 @@ static const int SEND_INPUT_OFFSET = 1;
 static const int DIGITAL_INPUT_PIN1 = 6;  //  Check for input on D6, which is connected to the pushbutton on the UnaShield V2S.
 static const int DIGITAL_INPUT_PIN2 = -1;  //  "-1" means currently unused.
 static const int DIGITAL_INPUT_PIN3 = -1;  //  "-1" means currently unused.
+static const unsigned long INPUT_CHECK_INTERVAL = 100;  //  Check the inputs every 0.1 seconds.
 
 //  Finite State Machine Events that will be triggered.  Assign a unique value to each event.
 static const int INPUT_CHANGED = 1;
 static const int INPUT_SENT = 2;
+static const int EVENT_COUNT = 3;  //  Events are numbered 0 to EVENT_COUNT - 1.
 
 //  Declare the Finite State Machine Functions that we will define later.
 void checkInput1(); void checkInput2(); void checkInput3();
@@ -65,60 +67,78 @@ void input1SendingToIdle(); void input2SendingToIdle(); void input3SendingToIdle
 void input1IdleToIdle(); void input2IdleToIdle(); void input3IdleToIdle();
 void checkPin(Fsm *fsm, int inputNum, int inputPin);
 void whenTransceiverIdle(); void whenTransceiverSending();
+void scheduleResend(); void transceiverSentToIdle(); void transceiverIdleToSending();
 
 //  Declare the Finite State Machine States for each input and for the Sigfox transceiver.
-//  Each state has 3 properties:
+//  Each state has 4 properties:
+//  "Number" - The number of the state in its Finite State Machine, from 0
 //  "When Entering State" - The function to run when entering this state
 //  "When Inside State" - The function to run repeatedly when we are in this state
 //  "When Exiting State" - The function to run when exiting this state and entering another state.
 //  Refer to the diagram: https://github.com/UnaBiz/unabiz-arduino/blob/master/examples/multiple_inputs/finite_state_machine.png
 
-//    Name of state   Enter  When inside state   Exit
-State input1Idle(     0,     &checkInput1,       0);  // In "Idle" state, we check
-State input2Idle(     0,     &checkInput2,       0);  // the input repeatedly for changes.
-State input3Idle(     0,     &checkInput3,       0);
-State input1Sending(  0,     0,                  0);  // In "Sending" state, we stop
-State input2Sending(  0,     0,                  0);  // checking the input temporarily
-State input3Sending(  0,     0,                  0);  // while the transceiver is sending.
-
-//    Name of state       Enter  When inside state         When exiting state
-State transceiverIdle(    0,     &whenTransceiverIdle,     0);  // Transceiver is idle until any input changes.
-State transceiverSending( 0,     &whenTransceiverSending,  0);  // Transceiver enters "Sending" state to send changed inputs.
-State transceiverSent(    0,     0,                        0);  // After sending, it waits 2.1 seconds in "Sent" state before going to "Idle" state.
+//              Name of state   Number  Enter  When inside state   Exit
+constexpr State input1Idle(     0,      0,     &checkInput1,       0);  // In "Idle" state, we check
+constexpr State input2Idle(     0,      0,     &checkInput2,       0);  // the input repeatedly for changes.
+constexpr State input3Idle(     0,      0,     &checkInput3,       0);
+constexpr State input1Sending(  1,      0,     0,                  0);  // In "Sending" state, we stop
+constexpr State input2Sending(  1,      0,     0,                  0);  // checking the input temporarily
+constexpr State input3Sending(  1,      0,     0,                  0);  // while the transceiver is sending.
+
+//              Name of state       Number  Enter  When inside state         When exiting state
+constexpr State transceiverIdle(    0,      0,     &whenTransceiverIdle,     0);  // Transceiver is idle until any input changes.
+constexpr State transceiverSending( 1,      0,     &whenTransceiverSending,  0);  // Transceiver enters "Sending" state to send changed inputs.
+constexpr State transceiverSent(    2,      0,     0,                        0);  // After sending, it waits 2.1 seconds in "Sent" state before going to "Idle" state.
+
+//  Declare the Finite State Machine Transitions for the sensors.  The transitions are
+//  compiled into a table indexed by state and event, so no memory is allocated at runtime.
+//  Each transition has 4 properties:
+//  "From State" - The starting state of the transition
+//  "To State" - The ending state of the transition
+//  "Triggering Event" - The event that will trigger the transition.
+//  "When Transitioning States" - The function to run when the state transition occurs.
+
+//  If the input has changed while in the "Idle" state, send the input and go to the "Sending" state,
+//  which will temporarily stop checking the input.  If we are in the "Sending" state and transceiver
+//  notifies us that the input has been sent, go into "Idle" state and resume checking the input.
+//  If the input has been sent and we are in "Idle" state, do nothing.
+//                                            From state      To state        Triggering event When transitioning states
+constexpr Transition input1Transitions[] = { { &input1Idle,    &input1Sending, INPUT_CHANGED,   &input1IdleToSending },
+                                             { &input1Sending, &input1Idle,    INPUT_SENT,      &input1SendingToIdle },
+                                             { &input1Idle,    &input1Idle,    INPUT_SENT,      &input1IdleToIdle } };
+constexpr Transition input2Transitions[] = { { &input2Idle,    &input2Sending, INPUT_CHANGED,   &input2IdleToSending },
+                                             { &input2Sending, &input2Idle,    INPUT_SENT,      &input2SendingToIdle },
+                                             { &input2Idle,    &input2Idle,    INPUT_SENT,      &input2IdleToIdle } };
+constexpr Transition input3Transitions[] = { { &input3Idle,    &input3Sending, INPUT_CHANGED,   &input3IdleToSending },
+                                             { &input3Sending, &input3Idle,    INPUT_SENT,      &input3SendingToIdle },
+                                             { &input3Idle,    &input3Idle,    INPUT_SENT,      &input3IdleToIdle } };
+
+constexpr FsmTable<2, EVENT_COUNT> input1Table = fsm_table<2, EVENT_COUNT>(input1Transitions);
+constexpr FsmTable<2, EVENT_COUNT> input2Table = fsm_table<2, EVENT_COUNT>(input2Transitions);
+constexpr FsmTable<2, EVENT_COUNT> input3Table = fsm_table<2, EVENT_COUNT>(input3Transitions);
+
+//  Declare the Finite State Machine Transitions for the transceiver.
+//                                                 From state           To state             Triggering event   When transitioning states
+constexpr Transition transceiverTransitions[] = { { &transceiverIdle,    &transceiverSending, INPUT_CHANGED,     0 },                 //  If inputs have changed when idle, send the inputs.
+                                                  { &transceiverSending, &transceiverSending, INPUT_CHANGED,     &scheduleResend },   //  If inputs have changed when busy, send the inputs later.
+                                                  { &transceiverSending, &transceiverSent,    INPUT_SENT,        0 },                 //  When inputs have been sent, go to the "Sent" state and wait 2.1 seconds.
+                                                  { &transceiverSent,    &transceiverSent,    INPUT_CHANGED,     &scheduleResend } }; //  If inputs have changed when busy, send the inputs later.
+
+//                                                           From state           To state             Interval (millisecs) When transitioning states
+constexpr TimedTransition transceiverTimedTransitions[] = { { &transceiverSent,    &transceiverIdle,    2100,                &transceiverSentToIdle },      //  Wait 2.1 seconds before next send.  Else the transceiver library will reject the send.
+                                                            { &transceiverIdle,    &transceiverSending, 30000,               &transceiverIdleToSending } }; //  If nothing has been sent in the past 30 seconds, send the inputs.
+
+constexpr FsmTable<3, EVENT_COUNT> transceiverTable = fsm_table<3, EVENT_COUNT>(transceiverTransitions, transceiverTimedTransitions);
 
 //  Declare the Finite State Machines for each input and for the Sigfox transceiver.
-//  Name of Finite State Machine    Starting state
-Fsm input1Fsm(                      &input1Idle);
-Fsm input2Fsm(                      &input2Idle);
-Fsm input3Fsm(                      &input3Idle);
-Fsm transceiverFsm(                 &transceiverIdle);
+//  Name of Finite State Machine    Starting state     Transition table
+Fsm input1Fsm(                      &input1Idle,       input1Table);
+Fsm input2Fsm(                      &input2Idle,       input2Table);
+Fsm input3Fsm(                      &input3Idle,       input3Table);
+Fsm transceiverFsm(                 &transceiverIdle,  transceiverTable);
 
 int lastInputValues[] = {0, 0, 0};  //  Remember the last value of each input.
 
-void addSensorTransitions() {
-  //  Add the Finite State Machine Transitions for the sensors.
-  //  Each state has 4 properties:
-  //  "From State" - The starting state of the transition
-  //  "To State" - The ending state of the transition
-  //  "Triggering Event" - The event that will trigger the transition.
-  //  "When Transitioning States" - The function to run when the state transition occurs.
-
-  //                        From state   To state        Triggering event When transitioning states
-  input1Fsm.add_transition( &input1Idle, &input1Sending, INPUT_CHANGED,   &input1IdleToSending); // If the input has changed while
-  input2Fsm.add_transition( &input2Idle, &input2Sending, INPUT_CHANGED,   &input2IdleToSending); // in the "Idle" state, send the input
-  input3Fsm.add_transition( &input3Idle, &input3Sending, INPUT_CHANGED,   &input3IdleToSending); // and go to the "Sending" state,
-                                                                                                 // which will temporarily stop checking the input.
-
-  input1Fsm.add_transition( &input1Sending, &input1Idle, INPUT_SENT,      &input1SendingToIdle); // If we are in the "Sending" state and
-  input2Fsm.add_transition( &input2Sending, &input2Idle, INPUT_SENT,      &input2SendingToIdle); // transceiver notifies us that the input
-  input3Fsm.add_transition( &input3Sending, &input3Idle, INPUT_SENT,      &input3SendingToIdle); // has been sent, go into "Idle" state
-                                                                                                 // and resume checking the input.
-
-  input1Fsm.add_transition( &input1Idle, &input1Idle,    INPUT_SENT,      &input1IdleToIdle); //  If the input has been sent and
-  input2Fsm.add_transition( &input2Idle, &input2Idle,    INPUT_SENT,      &input2IdleToIdle); // we are in "Idle" state, do nothing.
-  input3Fsm.add_transition( &input3Idle, &input3Idle,    INPUT_SENT,      &input3IdleToIdle);
-}
-
 void initSensors() {
   //  Initialise the sensors here, if necessary.
 }
@@ -187,26 +207,6 @@ void input3IdleToIdle() { Serial.println(F("Input #3 stays idle")); }
 
 int pendingResend = 0; //  How many times we have been asked to resend while the transceiver is already sending.
 
-void addTransceiverTransitions() {
-  //  Add the Finite State Machine Transitions for the transceiver.
-
-  //  From state           To state             Triggering event   When transitioning states
-  transceiverFsm.add_transition(                                   //  If inputs have changed when idle, send the inputs.
-      &transceiverIdle,    &transceiverSending, INPUT_CHANGED,     0);
-  transceiverFsm.add_transition(                                   //  If inputs have changed when busy, send the inputs later.
-      &transceiverSending, &transceiverSending, INPUT_CHANGED,     &scheduleResend);
-  transceiverFsm.add_transition(                                   //  When inputs have been sent, go to the "Sent" state
-      &transceiverSending, &transceiverSent,    INPUT_SENT,        0);  //  and wait 2.1 seconds.
-  transceiverFsm.add_transition(                                   //  If inputs have changed when busy, send the inputs later.
-      &transceiverSent,    &transceiverSent,    INPUT_CHANGED,     &scheduleResend);
-
-  //  From state           To state             Interval (millisecs) When transitioning states
-  transceiverFsm.add_timed_transition(                               //  Wait 2.1 seconds before next send.  Else the transceiver library
-      &transceiverSent,    &transceiverIdle,    2.1 * 1000,          &transceiverSentToIdle);  //  will reject the send.
-  transceiverFsm.add_timed_transition(                               //  If nothing has been sent in the past 30 seconds,
-      &transceiverIdle,    &transceiverSending, 30 * 1000,           &transceiverIdleToSending);  //  send the inputs.
-}
-
 void whenTransceiverSending() {
   //  Send the sensor values to Sigfox in a single Structured message.
   //  This occurs when the transceiver enters the "Sending" state.
@@ -280,10 +280,6 @@ void setup() {  //  Will be called only once.
   //  Initialize the sensors.
   initSensors();
 
-  //  Add the sensor and transceiver transitions for the Finite State Machine.
-  addSensorTransitions();
-  addTransceiverTransitions();
-
   //  Check whether the Sigfox module is functioning.
   if (!transceiver.begin()) stop("Unable to init Sigfox module, may be missing");  //  Will never return.
 }
@@ -295,7 +291,10 @@ void loop() {  //  Will be called repeatedly.
   if (DIGITAL_INPUT_PIN3 >= 0) input3Fsm.run_machine();
   transceiverFsm.run_machine();
 
-  delay(0.1 * 1000);  //  Wait 0.1 seconds between loops. Easier to debug.
+  //  Wait 0.1 seconds between loops to check the inputs, or less if a timed transition is due sooner.
+  unsigned long wait = transceiverFsm.nextDeadline();
+  if (wait > INPUT_CHECK_INTERVAL) wait = INPUT_CHECK_INTERVAL;
+  if (wait > 0) delay(wait);
 }
 
 //  End Main Program
@@ -0,0 +1,101 @@
+//  Arduino API for building the library natively on Linux / Mac without Arduino.
+//  Functions available on Arduino but missing on Linux / Mac.
+#include "Arduino.h"
+#include "Clock.h"
+
+HardwareSerial Serial;
+
+static char *unsignedToString(unsigned long num, char *str, int radix, bool negative) {
+  //  Convert the number to a string in the radix, lowercase like avr-libc.
+  char temp[8 * sizeof(num) + 1];
+  int len = 0;
+  do {
+    int digit = num % radix;
+    temp[len++] = (char) (digit < 10 ? digit + '0' : digit - 10 + 'a');
+    num = num / radix;
+  } while (num > 0);
+  char *s = str;
+  if (negative) *s++ = '-';
+  while (len > 0) *s++ = temp[--len];
+  *s = 0;
+  return str;
+}
+
+char *ltoa(long value, char *str, int radix) {
+  //  Only radix 10 is signed, like avr-libc.
+  if (radix == 10 && value < 0) return unsignedToString(-(unsigned long) value, str, radix, true);
+  return unsignedToString((unsigned long) value, str, radix, false);
+}
+
+char *ultoa(unsigned long value, char *str, int radix) {
+  return unsignedToString(value, str, radix, false);
+}
+
+char *itoa(int value, char *str, int radix) {
+  if (radix == 10) return ltoa(value, str, radix);
+  return unsignedToString((unsigned) value, str, radix, false);
+}
+
+char *utoa(unsigned value, char *str, int radix) {
+  return unsignedToString(value, str, radix, false);
+}
+
+char *dtostrf(double value, signed char width, unsigned char precision, char *str) {
+  sprintf(str, "%*.*f", width, precision, value);
+  return str;
+}
+
+//  Time comes from the clock installed with setClock(), normally the system clock.
+unsigned long millis() {
+  return (unsigned long) (getClock()->poll() / 1000);
+}
+
+unsigned long micros() {
+  return (unsigned long) getClock()->poll();
+}
+
+void delay(unsigned long ms) {
+  getClock()->sleep((uint64_t) ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+  getClock()->sleep(us);
+}
+
+//  There are no pins on Linux / Mac.
+void pinMode(uint8_t pin, uint8_t mode) {}
+void digitalWrite(uint8_t pin, uint8_t value) {}
+int digitalRead(uint8_t pin) { return LOW; }
+int analogRead(uint8_t pin) { return 0; }
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+  size_t n = 0;
+  while (size--) {
+    if (write(*buffer++)) n++;
+    else break;
+  }
+  return n;
+}
+
+size_t Print::print(long num, int base) {
+  if (base == 0) return write((uint8_t) num);
+  char buf[8 * sizeof(num) + 2];
+  return write(ltoa(num, buf, base));
+}
+
+size_t Print::print(unsigned long num, int base) {
+  if (base == 0) return write((uint8_t) num);
+  char buf[8 * sizeof(num) + 1];
+  return write(ultoa(num, buf, base));
+}
+
+size_t Print::print(double num, int digits) {
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%.*f", digits, num);
+  return write(buf);
+}
+
+size_t HardwareSerial::write(uint8_t ch) {
+  putchar(ch);
+  return 1;
+}
@@ -0,0 +1,108 @@
+//  Arduino API for building the library natively on Linux / Mac without Arduino,
+//  so that tests, benchmarks, fuzzers and simulators can link the real drivers.
+//  Covers what the library and the examples use: String, F(), Print, Stream,
+//  Serial, millis() / delay() and the digital / analog pin functions.
+#ifndef UNABIZ_HOST_ARDUINO_H
+#define UNABIZ_HOST_ARDUINO_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include "avr/pgmspace.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW  0x0
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+#define CHANGE 1
+#define LED_BUILTIN 13
+#define A0 14
+#define DEC 10
+#define HEX 16
+
+//  Number conversion functions provided by avr-libc.
+char *itoa(int value, char *str, int radix);
+char *utoa(unsigned value, char *str, int radix);
+char *ltoa(long value, char *str, int radix);
+char *ultoa(unsigned long value, char *str, int radix);
+char *dtostrf(double value, signed char width, unsigned char precision, char *str);
+
+#include "LocalWString.h"
+
+unsigned long millis();  //  Milliseconds since start.
+unsigned long micros();  //  Microseconds since start.
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+
+class Print
+{
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t ch) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  size_t write(const char *str) { return str ? write((const uint8_t *) str, strlen(str)) : 0; }
+  size_t write(const char *buffer, size_t size) { return write((const uint8_t *) buffer, size); }
+
+  size_t print(const __FlashStringHelper *str) { return write(reinterpret_cast<const char *>(str)); }
+  size_t print(const String &str) { return write(str.c_str(), str.length()); }
+  size_t print(const char str[]) { return write(str); }
+  size_t print(char ch) { return write((uint8_t) ch); }
+  size_t print(unsigned char num, int base = DEC) { return print((unsigned long) num, base); }
+  size_t print(int num, int base = DEC) { return print((long) num, base); }
+  size_t print(unsigned int num, int base = DEC) { return print((unsigned long) num, base); }
+  size_t print(long num, int base = DEC);
+  size_t print(unsigned long num, int base = DEC);
+  size_t print(double num, int digits = 2);
+
+  size_t println() { return write("\r\n"); }
+  template <typename T> size_t println(T value) { size_t n = print(value); return n + println(); }
+  template <typename T> size_t println(T value, int format) { size_t n = print(value, format); return n + println(); }
+
+  int getWriteError() { return writeError; }
+  void clearWriteError() { writeError = 0; }
+
+protected:
+  void setWriteError(int err = 1) { writeError = err; }
+
+private:
+  int writeError = 0;
+};
+
+class Stream: public Print
+{
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  virtual void flush() {}
+};
+
+//  Serial console.  Output goes to stdout, there is no input.
+class HardwareSerial: public Stream
+{
+public:
+  void begin(unsigned long baud) {}
+  void end() {}
+  virtual int available() { return 0; }
+  virtual int read() { return -1; }
+  virtual int peek() { return -1; }
+  virtual size_t write(uint8_t ch);
+  using Print::write;
+  operator bool() { return true; }
+};
+
+extern HardwareSerial Serial;
+
+#endif  //  UNABIZ_HOST_ARDUINO_H
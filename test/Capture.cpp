@@ -0,0 +1,122 @@
+//  Record and replay the serial traffic between the drivers and the SIGFOX module.
+#include <string.h>
+#include "Capture.h"
+#include "Clock.h"
+
+static const char header[] = "UBZCAP1\n";
+static const size_t headerSize = 8, recordSize = 12;
+
+CaptureWriter::CaptureWriter():
+  records(0),
+  file(0) {}
+
+CaptureWriter::~CaptureWriter() {
+  close();
+}
+
+bool CaptureWriter::open(const char *path) {
+  close();
+  file = fopen(path, "wb");
+  if (!file) return false;
+  //  Records are small, so buffer them to keep the hook cheap.
+  setvbuf(file, 0, _IOFBF, 64 * 1024);
+  records = 0;
+  return fwrite(header, 1, headerSize, file) == headerSize;
+}
+
+void CaptureWriter::close() {
+  if (file) fclose(file);
+  file = 0;
+}
+
+void CaptureWriter::record(uint8_t port, bool transmit, uint8_t ch) {
+  if (!file) return;
+  uint8_t buf[recordSize];
+  const uint64_t time = getClock()->now();
+  for (int i = 0; i < 8; i++) buf[i] = (uint8_t) (time >> (8 * i));
+  buf[8] = port;
+  buf[9] = transmit ? 1 : 0;
+  buf[10] = ch;
+  buf[11] = 0;
+  fwrite(buf, 1, recordSize, file);
+  records++;
+}
+
+void CaptureWriter::hook(void *context, bool transmit, uint8_t ch) {
+  CapturePort *port = (CapturePort *) context;
+  port->writer->record(port->id, transmit, ch);
+}
+
+bool loadCapture(const char *path, std::vector<CaptureRecord> &records) {
+  FILE *file = fopen(path, "rb");
+  if (!file) return false;
+  uint8_t buf[recordSize];
+  bool ok = fread(buf, 1, headerSize, file) == headerSize && memcmp(buf, header, headerSize) == 0;
+  while (ok && fread(buf, 1, recordSize, file) == recordSize) {
+    CaptureRecord rec;
+    rec.time = 0;
+    for (int i = 7; i >= 0; i--) rec.time = (rec.time << 8) | buf[i];
+    rec.port = buf[8];
+    rec.transmit = buf[9] != 0;
+    rec.ch = buf[10];
+    records.push_back(rec);
+  }
+  fclose(file);
+  return ok;
+}
+
+ReplaySerial::ReplaySerial(const std::vector<CaptureRecord> &records, uint8_t port, double speedup0):
+  mismatches(0),
+  cursor(0),
+  speedup(speedup0 > 0 ? speedup0 : 1) {
+  for (size_t i = 0; i < records.size(); i++)
+    if (records[i].port == port) session.push_back(records[i]);
+}
+
+void ReplaySerial::begin(long speed) {
+  //  Bytes received before the first command are replayed from the first begin().
+  if (cursor == 0 && !session.empty()) replayReceived(session[0].time);
+}
+
+void ReplaySerial::replayReceived(uint64_t anchor) {
+  //  Queue the received bytes up to the next sent byte, delayed as recorded from anchor.
+  Clock *clock = getClock();
+  const uint64_t now = clock->now();
+  for (; cursor < session.size() && !session[cursor].transmit; cursor++) {
+    Output out = { now + (uint64_t) ((session[cursor].time - anchor) / speedup), session[cursor].ch };
+    if (!output.empty() && out.due < output.back().due) out.due = output.back().due;
+    output.push_back(out);
+    clock->schedule(out.due);
+  }
+}
+
+size_t ReplaySerial::write(uint8_t ch) {
+  if (cursor >= session.size()) { mismatches++; return 1; }  //  Driver sent more than the capture.
+  const CaptureRecord &rec = session[cursor++];
+  if (rec.ch != ch) mismatches++;
+  replayReceived(rec.time);
+  return 1;
+}
+
+int ReplaySerial::available() {
+  const uint64_t now = getClock()->now(); int count = 0;
+  for (std::deque<Output>::const_iterator it = output.begin();
+       it != output.end() && it->due <= now; it++) count++;
+  return count;
+}
+
+int ReplaySerial::read() {
+  if (output.empty() || output.front().due > getClock()->now()) return -1;
+  uint8_t ch = output.front().ch;
+  output.pop_front();
+  return ch;
+}
+
+int ReplaySerial::peek() {
+  if (output.empty() || output.front().due > getClock()->now()) return -1;
+  return output.front().ch;
+}
+
+void ReplaySerial::flush() {
+  while (read() >= 0) {}
+}
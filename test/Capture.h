@@ -0,0 +1,85 @@
+//  Record and replay the serial traffic between the drivers and the SIGFOX module.
+//  CaptureWriter records the bytes passed to the capture hook of each transceiver
+//  (setCaptureHook), with timestamps, into a capture file.  ReplaySerial plays back
+//  the module side of a captured session to a driver, at the recorded speed or
+//  faster, so that captures from field units become benchmark and regression inputs.
+//
+//  Capture file: the 8-byte header "UBZCAP1\n", then a 12-byte record per byte:
+//    uint64  time in microseconds, little-endian
+//    uint8   port, to tell apart transceivers in the same capture
+//    uint8   1 if sent to the module, 0 if received from the module
+//    uint8   the byte
+//    uint8   0, reserved
+#ifndef UNABIZ_HOST_CAPTURE_H
+#define UNABIZ_HOST_CAPTURE_H
+
+#include <stdio.h>
+#include <deque>
+#include <vector>
+#include "SerialStream.h"
+
+struct CaptureRecord
+{
+  uint64_t time;  //  Microseconds.
+  uint8_t port;
+  bool transmit;  //  True if sent to the module.
+  uint8_t ch;
+};
+
+class CaptureWriter;
+
+//  Context for the capture hook of one transceiver:
+//    CapturePort port = { &writer, 0 };  wisol.setCaptureHook(CaptureWriter::hook, &port);
+struct CapturePort
+{
+  CaptureWriter *writer;
+  uint8_t id;
+};
+
+class CaptureWriter
+{
+public:
+  CaptureWriter();
+  ~CaptureWriter();
+  bool open(const char *path);  //  Create the capture file.  Returns false if failed.
+  void close();
+  void record(uint8_t port, bool transmit, uint8_t ch);  //  Timestamp is from the clock of this thread.
+  static void hook(void *context, bool transmit, uint8_t ch);  //  SerialCaptureHook, context is a CapturePort.
+  unsigned long records;  //  Number of records written.
+
+private:
+  FILE *file;
+};
+
+//  Read all records in the capture file.  Returns false if the file is missing or invalid.
+bool loadCapture(const char *path, std::vector<CaptureRecord> &records);
+
+//  Serial port that plays back the module side of a captured session.  Each byte
+//  written by the driver is matched with the next byte sent in the capture, then
+//  the bytes received after it in the capture are returned to the driver with the
+//  recorded delays divided by speedup.
+class ReplaySerial: public SerialStream
+{
+public:
+  ReplaySerial(const std::vector<CaptureRecord> &records, uint8_t port, double speedup = 1);
+  virtual void begin(long speed);
+  virtual size_t write(uint8_t ch);
+  virtual int available();
+  virtual int read();
+  virtual int peek();
+  virtual void flush();  //  Discard the bytes that are due, like BeanSoftwareSerial.
+  using Print::write;
+
+  bool finished() const { return cursor >= session.size() && output.empty(); }
+  unsigned long mismatches;  //  Bytes written by the driver that differ from the capture.
+
+private:
+  void replayReceived(uint64_t anchor);  //  Queue the received bytes at the cursor.
+  struct Output { uint64_t due; uint8_t ch; };
+  std::vector<CaptureRecord> session;  //  Records for our port.
+  size_t cursor;  //  Next record to replay.
+  double speedup;
+  std::deque<Output> output;  //  Received bytes waiting to be read by the driver.
+};
+
+#endif  //  UNABIZ_HOST_CAPTURE_H
@@ -0,0 +1,62 @@
+//  Clock behind millis(), micros() and delay() when building without Arduino.
+#include <chrono>
+#include <thread>
+#include "Clock.h"
+
+static const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+static SystemClock systemClock;
+static thread_local Clock *currentClock = 0;  //  Each simulator thread may have its own clock.
+
+uint64_t SystemClock::now() {
+  return (uint64_t) std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - startTime).count();
+}
+
+void SystemClock::sleep(uint64_t us) {
+  std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+VirtualClock::VirtualClock(uint64_t start, uint64_t pollStep0):
+  time(start),
+  pollStep(pollStep0),
+  polls(0),
+  polled(false) {}
+
+uint64_t VirtualClock::poll() {
+  //  Jump to the next deadline, or by pollStep if none.  The first poll after
+  //  sleeping doesn't move, so code that reads the time right after a delay
+  //  (e.g. to time a step) sees the time of the delay, not of the next deadline.
+  polls++;
+  if (!polled) { polled = true; return time; }
+  expireDeadlines();
+  if (deadlines.empty()) time = time + pollStep;
+  else { time = deadlines.top(); deadlines.pop(); }
+  return time;
+}
+
+void VirtualClock::sleep(uint64_t us) {
+  polled = false;
+  time = time + us;
+  expireDeadlines();
+}
+
+void VirtualClock::advance(uint64_t us) {
+  time = time + us;
+  expireDeadlines();
+}
+
+void VirtualClock::schedule(uint64_t deadline) {
+  if (deadline > time) deadlines.push(deadline);
+}
+
+void VirtualClock::expireDeadlines() {
+  while (!deadlines.empty() && deadlines.top() <= time) deadlines.pop();
+}
+
+void setClock(Clock *clock) {
+  currentClock = clock;
+}
+
+Clock *getClock() {
+  return currentClock ? currentClock : &systemClock;
+}
@@ -0,0 +1,62 @@
+//  Clock behind millis(), micros() and delay() when building without Arduino.
+//  By default the system clock is used.  Tests and simulators may install a
+//  VirtualClock so that timeouts, SEND_DELAY and timed transitions take no
+//  wall-clock time.
+#ifndef UNABIZ_HOST_CLOCK_H
+#define UNABIZ_HOST_CLOCK_H
+
+#include <stdint.h>
+#include <queue>
+#include <vector>
+#include <functional>
+
+class Clock
+{
+public:
+  virtual ~Clock() {}
+  virtual uint64_t now() = 0;  //  Microseconds since start.
+  virtual uint64_t poll() { return now(); }  //  Called by millis() and micros().
+  virtual void sleep(uint64_t us) = 0;  //  Called by delay() and delayMicroseconds().
+  virtual void schedule(uint64_t deadline) {}  //  Hint that something will happen at this time.
+};
+
+//  Real time.
+class SystemClock: public Clock
+{
+public:
+  virtual uint64_t now();
+  virtual void sleep(uint64_t us);
+};
+
+//  Simulated time that only moves when code sleeps or polls.  delay() jumps
+//  forward by the delay.  Repeated calls to millis() / micros() (i.e. busy
+//  waiting) jump forward to the next deadline set with schedule() (e.g. when
+//  a simulated module will respond), or by pollStep if there is no pending
+//  deadline, so busy-wait loops with timeouts still end after a bounded number
+//  of polls.
+class VirtualClock: public Clock
+{
+public:
+  VirtualClock(uint64_t start = 0, uint64_t pollStep = 1000);
+  virtual uint64_t now() { return time; }  //  Current time without moving the clock.
+  virtual uint64_t poll();  //  Jump to the next deadline and return the time.
+  virtual void sleep(uint64_t us);
+  virtual void schedule(uint64_t deadline);  //  Stop at this time (microseconds) when polled.
+  void advance(uint64_t us);  //  Move the clock forward, e.g. between test steps.
+  void setPollStep(uint64_t us) { pollStep = us; }
+  uint64_t getPolls() const { return polls; }  //  Number of times the clock was polled.
+
+private:
+  void expireDeadlines();  //  Drop deadlines that are not in the future.
+  uint64_t time;
+  uint64_t pollStep;
+  uint64_t polls;
+  bool polled;  //  True if polled since the last sleep.
+  std::priority_queue<uint64_t, std::vector<uint64_t>, std::greater<uint64_t> > deadlines;
+};
+
+//  Install the clock used by the current thread.  Pass 0 to restore the system clock.
+void setClock(Clock *clock);
+Clock *getClock();
+
+#endif  //  UNABIZ_HOST_CLOCK_H
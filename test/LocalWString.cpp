@@ -1,4 +1,4 @@
-#ifndef ARDUINO
+#if !defined(ARDUINO) || defined(UNABIZ_HOST)
 /*
   WString.cpp - String library for Wiring & Arduino
   ...mostly rewritten by Paul Stoffregen...
@@ -20,7 +20,7 @@
   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 */
 
-#include "LocalWString.h"
+#include "Arduino.h"  //  Declares String and the itoa() / dtostrf() functions used here.
 
 /*********************************************/
 /*  Constructors                             */
@@ -0,0 +1,297 @@
+//  Simulated SIGFOX modules for testing and benchmarking the drivers without a radio.
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+#include "ModemEmulator.h"
+#include "Clock.h"
+#include "Hex.h"
+
+ModemEmulator::ModemEmulator(const ModemConfig &config0):
+  config(config0),
+  random(config0.seed) {}
+
+ModemEmulator::~ModemEmulator() {
+  closePty();
+}
+
+bool ModemEmulator::drop() {
+  //  Return true if the next byte should be dropped.
+  if (config.dropRate <= 0) return false;
+  if (std::uniform_real_distribution<double>(0, 1)(random) >= config.dropRate) return false;
+  dropped++;
+  return true;
+}
+
+uint64_t ModemEmulator::responseDelay() {
+  //  Latency plus jitter for the next response.
+  if (config.jitter == 0) return config.latency;
+  return config.latency + std::uniform_int_distribution<uint64_t>(0, config.jitter)(random);
+}
+
+void ModemEmulator::respond(const uint8_t *data, size_t length, uint64_t delay) {
+  //  Queue the bytes to be sent after the delay, one byteTime apart, after any
+  //  bytes already queued.  Tell the clock when each byte is due.
+  Clock *clock = getClock();
+  uint64_t due = clock->now() + delay;
+  if (due < lastDue) due = lastDue;
+  for (size_t i = 0; i < length; i++) {
+    due = due + config.byteTime;
+    if (drop()) continue;
+    Output out = { due, data[i] };
+    output.push_back(out);
+    clock->schedule(due);
+  }
+  lastDue = due;
+}
+
+void ModemEmulator::respond(const char *text, uint64_t delay) {
+  respond((const uint8_t *) text, strlen(text), delay);
+}
+
+size_t ModemEmulator::write(uint8_t ch) {
+  //  Driver sends a byte to the module.
+  if (!drop()) receive(ch);
+  return 1;
+}
+
+bool ModemEmulator::lineOk() {
+  //  A byte sent at the wrong rate reaches the module as noise.
+  if (config.bitsPerSecond == 0 || lineSpeed == 0 || lineSpeed == config.bitsPerSecond) return true;
+  garbled++;
+  return false;
+}
+
+void ModemEmulator::setBitsPerSecond(long bitsPerSecond) {
+  //  Switch the UART rate.  Each byte on the wire is 10 bits.
+  config.bitsPerSecond = bitsPerSecond;
+  config.byteTime = 10000000 / bitsPerSecond;
+}
+
+int ModemEmulator::available() {
+  //  Count the bytes that the module has sent by now.
+  uint64_t now = getClock()->now(); int count = 0;
+  for (std::deque<Output>::const_iterator it = output.begin();
+       it != output.end() && it->due <= now; it++) count++;
+  return count;
+}
+
+int ModemEmulator::read() {
+  if (output.empty() || output.front().due > getClock()->now()) return -1;
+  uint8_t ch = output.front().ch;
+  output.pop_front();
+  return ch;
+}
+
+void ModemEmulator::flush() {
+  while (read() >= 0) {}
+}
+
+void ModemEmulator::uplink(const String &payload, uint64_t delay) {
+  uplinks++;
+  lastUplink = payload;
+  if (uplinkHandler) uplinkHandler(uplinkContext, getClock()->now() + delay, payload);
+}
+
+int ModemEmulator::peek() {
+  if (output.empty() || output.front().due > getClock()->now()) return -1;
+  return output.front().ch;
+}
+
+const char *ModemEmulator::openPty() {
+  //  Open a pseudo-terminal in raw mode.  The program under test opens the returned path.
+  closePty();
+  ptyFd = posix_openpt(O_RDWR | O_NOCTTY);
+  if (ptyFd < 0) return 0;
+  if (grantpt(ptyFd) != 0 || unlockpt(ptyFd) != 0 || !ptsname(ptyFd)) { closePty(); return 0; }
+  strncpy(ptyPath, ptsname(ptyFd), sizeof(ptyPath) - 1);
+  ptyPath[sizeof(ptyPath) - 1] = 0;
+  ptySlaveFd = open(ptyPath, O_RDWR | O_NOCTTY);
+  if (ptySlaveFd < 0) { closePty(); return 0; }
+  struct termios tio;
+  tcgetattr(ptySlaveFd, &tio);
+  cfmakeraw(&tio);
+  tcsetattr(ptySlaveFd, TCSANOW, &tio);
+  fcntl(ptyFd, F_SETFL, fcntl(ptyFd, F_GETFL) | O_NONBLOCK);
+  return ptyPath;
+}
+
+void ModemEmulator::closePty() {
+  if (ptySlaveFd >= 0) close(ptySlaveFd);
+  if (ptyFd >= 0) close(ptyFd);
+  ptyFd = ptySlaveFd = -1;
+}
+
+void ModemEmulator::servePty(int timeoutMs) {
+  //  Pass bytes from the pty to the module and send the module's responses
+  //  when they are due, for up to timeoutMs.  Uses the clock of this thread.
+  if (ptyFd < 0) return;
+  Clock *clock = getClock();
+  const uint64_t end = clock->now() + (uint64_t) timeoutMs * 1000;
+  for (;;) {
+    //  Send the responses that are due.
+    uint8_t buf[256]; size_t len = 0;
+    for (int ch = read(); ch >= 0; ch = read()) {
+      buf[len++] = (uint8_t) ch;
+      if (len == sizeof(buf)) { if (::write(ptyFd, buf, len) < 0) return; len = 0; }
+    }
+    if (len > 0 && ::write(ptyFd, buf, len) < 0) return;
+
+    //  Wait for commands until the next response is due or we time out.
+    uint64_t now = clock->now();
+    if (now >= end) return;
+    uint64_t wake = end;
+    if (!output.empty() && output.front().due < wake) wake = output.front().due;
+    struct pollfd pfd = { ptyFd, POLLIN, 0 };
+    int waitMs = (int) ((wake - now + 999) / 1000);
+    if (poll(&pfd, 1, waitMs) <= 0) continue;
+    ssize_t count = ::read(ptyFd, buf, sizeof(buf));
+    for (ssize_t i = 0; i < count; i++) write(buf[i]);
+  }
+}
+
+WisolEmulator::WisolEmulator(const ModemConfig &config): ModemEmulator(config) {}
+
+void WisolEmulator::receive(uint8_t ch) {
+  //  Commands end with '\r'.  Ignore '\n'.  A sleeping module is woken by the
+  //  first byte received (e.g. a break) and ignores bytes until it is awake.
+  const uint64_t now = getClock()->now();
+  if (sleeping) { sleeping = false; wakeups++; awake = now + config.wakeTime; line = ""; return; }
+  if (now < awake || !lineOk()) return;
+  if (ch == '\n') return;
+  if (ch != '\r') {
+    if (line.length() < 64) line.concat((char) ch);
+    return;
+  }
+  handleCommand(line);
+  line = "";
+}
+
+static bool isHex(const String &str) {
+  for (unsigned i = 0; i < str.length(); i++)
+    if (hexDigitToNibble(str.charAt(i)) == 0xff) return false;
+  return true;
+}
+
+void WisolEmulator::handleCommand(const String &cmd) {
+  //  Respond to the command like the WSSFM10R.
+  commands++;
+  const uint64_t delay = responseDelay();
+  if (cmd.startsWith("AT$SF=")) {
+    //  Send payload, with ",1" for downlink.
+    String payload = cmd.substring(6);
+    const bool wantDownlink = payload.endsWith(",1");
+    if (wantDownlink) payload = payload.substring(0, payload.length() - 2);
+    if (payload.length() > 24 || payload.length() % 2 != 0 || !isHex(payload)) {
+      respond("ERROR\r\n", delay); return;
+    }
+    uplink(payload, delay + config.uplinkTime);
+    if (channelY > 0) channelY--;  //  Each uplink uses a micro channel.
+    if (channelY == 0) channelX = 0;
+    respond("OK\r\n", delay + config.uplinkTime);
+    if (!wantDownlink) return;
+    //  Downlink is returned as "RX=01 23 45 67 89 AB CD EF".
+    String rx = "RX=";
+    for (unsigned i = 0; i + 1 < strlen(config.downlink); i = i + 2) {
+      if (i > 0) rx.concat(' ');
+      rx.concat(config.downlink[i]); rx.concat(config.downlink[i + 1]);
+    }
+    rx.concat("\r\n");
+    downlinks++;
+    respond(rx.c_str(), delay + config.uplinkTime + config.downlinkTime);
+  }
+  else if (cmd == "AT$GI?") respond((String(channelX) + ',' + String(channelY) + "\r\n").c_str(), delay);
+  else if (cmd == "AT$RC") { channelX = 1; channelY = 7; respond("OK\r\n", delay); }
+  else if (cmd == "AT$I=10") respond((String(config.id) + "\r\n").c_str(), delay);
+  else if (cmd == "AT$I=11") respond((String(config.pac) + "\r\n").c_str(), delay);
+  else if (cmd == "AT$T?") respond((String(config.temperature) + "\r\n").c_str(), delay);
+  else if (cmd == "AT$V?") respond((String(config.voltage) + "\r\n").c_str(), delay);
+  else if (cmd == "AT$P=1") { respond("OK\r\n", delay); sleeping = true; }
+  else if (cmd == "AT" || cmd.startsWith("ATS410=") || cmd.startsWith("ATS302=")
+           || cmd.startsWith("AT$P=") || cmd.startsWith("AT$IF=") || cmd.startsWith("AT$CB="))
+    respond("OK\r\n", delay);
+  else respond("ERROR\r\n", delay);
+}
+
+RadiocraftsEmulator::RadiocraftsEmulator(const ModemConfig &config): ModemEmulator(config) {
+  memset(memory, 0, sizeof(memory));
+  memory[0x00] = 3;  //  RF_FREQUENCY_DOMAIN: RCZ4
+  memory[0x01] = 14;  //  RF_POWER
+  memory[0x28] = 0;  //  PUBLIC_KEY: Unique ID & key
+  memory[0x30] = 5;  //  UART_BAUD: 19200 bps
+}
+
+void RadiocraftsEmulator::respondPrompt(const uint8_t *data, size_t length) {
+  //  Respond with the data followed by the '>' prompt.
+  uint8_t buf[16];
+  memcpy(buf, data, length);
+  buf[length] = '>';
+  respond(buf, length + 1, responseDelay());
+}
+
+void RadiocraftsEmulator::receive(uint8_t ch) {
+  //  Handle the byte according to the current mode.
+  if (!lineOk()) return;
+  switch (mode) {
+    case SEND:
+      if (messageLength == 0) {
+        if (ch == 0x00) { mode = COMMAND; respondPrompt(0, 0); return; }  //  Enter Command Mode.
+        if (ch > 12) return;  //  Not a valid payload length.
+      }
+      message[messageLength++] = ch;
+      if (messageLength < (size_t) message[0] + 1) return;
+      //  Received the whole payload.  Transmit it.
+      {
+        String payload;
+        for (size_t i = 1; i < messageLength; i++) {
+          static const char nibbleToHex[] = "0123456789abcdef";
+          payload.concat(nibbleToHex[message[i] >> 4]);
+          payload.concat(nibbleToHex[message[i] & 0xf]);
+        }
+        uplink(payload, config.uplinkTime);
+      }
+      messageLength = 0;
+      return;
+
+    case COMMAND:
+      commands++;
+      if (messageLength > 0) {  //  Address for 'Y' (read memory).
+        messageLength = 0;
+        respondPrompt(&memory[ch], 1);
+        return;
+      }
+      switch (ch) {
+        case 'X': mode = SEND; return;  //  Exit to Send Mode, no response.
+        case 'M': mode = CONFIG; respondPrompt(0, 0); return;
+        case 'Y': messageLength = 1; respondPrompt(0, 0); return;  //  Address follows.
+        case '9': {  //  4 bytes ID (LSB first) and 8 bytes PAC (MSB first).
+          uint8_t buf[12], id[4];
+          hexToBytes(config.id, 8, id);
+          for (int i = 0; i < 4; i++) buf[i] = id[3 - i];
+          hexToBytes(config.pac, 16, buf + 4);
+          respondPrompt(buf, 12);
+          return;
+        }
+        case 'U': { uint8_t t = (uint8_t) (config.temperature / 10 + 128); respondPrompt(&t, 1); return; }
+        case 'V': { uint8_t v = (uint8_t) (config.voltage / 30); respondPrompt(&v, 1); return; }
+        default: respondPrompt(0, 0); return;
+      }
+
+    case CONFIG:
+      commands++;
+      if (messageLength == 0 && ch == 0xff) {
+        //  Exit to Command Mode.  A new UART_BAUD takes effect after the prompt.
+        mode = COMMAND; respondPrompt(0, 0);
+        static const long rates[] = { 0, 2400, 4800, 9600, 14400, 19200, 28800, 38400, 57600, 76800, 115200 };
+        if (memory[0x30] >= 1 && memory[0x30] <= 10 && rates[memory[0x30]] != config.bitsPerSecond
+            && config.bitsPerSecond != 0) setBitsPerSecond(rates[memory[0x30]]);
+        return;
+      }
+      message[messageLength++] = ch;
+      if (messageLength < 2) return;
+      if (!dropConfigWrites) memory[message[0]] = message[1];  //  Address, value.
+      messageLength = 0;
+      return;
+  }
+}
@@ -0,0 +1,129 @@
+//  Simulated SIGFOX modules for testing and benchmarking the drivers without a radio.
+//  WisolEmulator answers the WSSFM10R AT commands used by Wisol.cpp, RadiocraftsEmulator
+//  answers the RC1692HP binary protocol used by Radiocrafts.cpp.  Responses are
+//  delayed by a configurable latency and jitter, bytes may be dropped at random,
+//  and downlink payloads may be configured.  An emulator may be used in-process as
+//  the serial port of a driver, or connected to the SoftwareSerial pins of the driver,
+//  or over a Linux pseudo-terminal, which looks like a USB serial port to the program
+//  under test.  Time comes from the clock of the calling thread, see Clock.h.
+#ifndef UNABIZ_HOST_MODEMEMULATOR_H
+#define UNABIZ_HOST_MODEMEMULATOR_H
+
+#include <deque>
+#include <random>
+#include "SerialStream.h"
+
+struct ModemConfig
+{
+  uint64_t latency = 20000;  //  Microseconds before the module responds to a command.
+  uint64_t jitter = 5000;  //  Up to this many microseconds are added to the latency at random.
+  uint64_t uplinkTime = 6000000;  //  Microseconds to transmit an uplink (3 repetitions).
+  uint64_t downlinkTime = 20000000;  //  Microseconds from end of uplink to downlink received.
+  uint64_t byteTime = 1042;  //  Microseconds per byte on the wire (10 bits at 9600 bps).
+  double dropRate = 0;  //  Probability that each byte in either direction is lost.
+  unsigned seed = 1;  //  Seed for jitter and drops, so runs are repeatable.
+  const char *id = "002C30EB";  //  SIGFOX ID as 8 hex digits.
+  const char *pac = "A8664B5523B5405D";  //  PAC as 16 hex digits.
+  const char *downlink = "0123456789ABCDEF";  //  Downlink payload as 16 hex digits.
+  int temperature = 322;  //  Module temperature in tenths of a degree C.
+  int voltage = 3300;  //  Supply voltage in millivolts.
+  uint64_t wakeTime = 20000;  //  Microseconds for the Wisol module to wake from AT$P=1 sleep.
+  long bitsPerSecond = 0;  //  UART rate of the module.  Bytes sent at another rate are garbled.  0 for any rate.
+};
+
+//  Called when the module transmits an uplink.  time is when the transmission
+//  ends (microseconds), payload is in hex.
+typedef void (*UplinkHandler)(void *context, uint64_t time, const String &payload);
+
+class ModemEmulator: public SerialStream
+{
+public:
+  ModemEmulator(const ModemConfig &config);
+  virtual ~ModemEmulator();
+
+  //  Serial port used by the driver: write() sends to the module, read() returns
+  //  bytes from the module once they are due.
+  virtual void begin(long speed) { lineSpeed = speed; }  //  Rate used by the driver.
+  virtual size_t write(uint8_t ch);
+  virtual int available();
+  virtual int read();
+  virtual int peek();
+  virtual void flush();  //  Discard the bytes that are due, like BeanSoftwareSerial.
+  using Print::write;
+
+  //  Serve the module over a pseudo-terminal.  Returns the device path to be
+  //  opened by the program under test, or 0 if failed.
+  const char *openPty();
+  void servePty(int timeoutMs);  //  Exchange bytes with the pty for up to timeoutMs.
+  int getPtyFd() const { return ptyFd; }
+  void closePty();
+
+  ModemConfig config;
+  unsigned long commands = 0;  //  Number of commands received.
+  unsigned long uplinks = 0;  //  Number of uplink messages transmitted.
+  unsigned long downlinks = 0;  //  Number of downlink messages returned.
+  unsigned long dropped = 0;  //  Number of bytes dropped.
+  unsigned long garbled = 0;  //  Number of bytes sent by the driver at the wrong rate.
+  String lastUplink;  //  Payload of the last uplink in hex.
+  UplinkHandler uplinkHandler = 0;  //  Called for each uplink if set.
+  void *uplinkContext = 0;
+
+protected:
+  virtual void receive(uint8_t ch) = 0;  //  Handle a byte sent to the module.
+  void respond(const uint8_t *data, size_t length, uint64_t delay);  //  Send bytes after the delay (us).
+  void respond(const char *text, uint64_t delay);
+  uint64_t responseDelay();  //  Latency plus jitter for the next response.
+  void uplink(const String &payload, uint64_t delay);  //  Count the uplink, which ends after the delay.
+  bool lineOk();  //  Return true if the driver uses the rate of the module.  Else count the byte as garbled.
+  void setBitsPerSecond(long bitsPerSecond);  //  Switch the module UART to this rate.
+
+private:
+  bool drop();
+  struct Output { uint64_t due; uint8_t ch; };
+  std::deque<Output> output;  //  Bytes waiting to be sent by the module.
+  uint64_t lastDue = 0;  //  When the last queued byte will be sent.
+  long lineSpeed = 0;  //  Rate that the driver opened the port with, 0 if unknown.
+  std::mt19937 random;
+  int ptyFd = -1;  //  Master side of the pty, used by the emulator.
+  int ptySlaveFd = -1;  //  Kept open so the master does not see a hangup between sessions.
+  char ptyPath[64];
+};
+
+//  Wisol WSSFM10R: AT commands ending with '\r', responses ending with "\r\n".
+class WisolEmulator: public ModemEmulator
+{
+public:
+  WisolEmulator(const ModemConfig &config = ModemConfig());
+  int channelX = 1, channelY = 7;  //  Channel availability returned by AT$GI? (RCZ2, RCZ4).
+  bool sleeping = false;  //  After AT$P=1 the module ignores commands until woken by a break.
+  unsigned long wakeups = 0;  //  Number of times the module was woken.
+
+protected:
+  virtual void receive(uint8_t ch);
+
+private:
+  void handleCommand(const String &cmd);
+  String line;  //  Command received so far.
+  uint64_t awake = 0;  //  Time when the module finishes waking up.
+};
+
+//  Radiocrafts RC1692HP-SIG: binary protocol.  In Send Mode the first byte is the
+//  payload length.  0x00 enters Command Mode, where each command ends with a '>' prompt.
+class RadiocraftsEmulator: public ModemEmulator
+{
+public:
+  RadiocraftsEmulator(const ModemConfig &config = ModemConfig());
+  enum { SEND, COMMAND, CONFIG } mode = SEND;
+  uint8_t memory[256];  //  Configuration memory, read with 'Y' and written in Config Mode.
+  bool dropConfigWrites = false;  //  Ignore config writes, e.g. lost to a module reset.
+
+protected:
+  virtual void receive(uint8_t ch);
+
+private:
+  void respondPrompt(const uint8_t *data, size_t length);  //  Respond with data followed by '>'.
+  uint8_t message[13];  //  Payload being received in Send Mode, or command bytes in Command / Config Mode.
+  size_t messageLength = 0;
+};
+
+#endif  //  UNABIZ_HOST_MODEMEMULATOR_H
@@ -0,0 +1,21 @@
+//  Serial port interface used by the drivers when building natively on Linux / Mac.
+//  Same calls as the Arduino SoftwareSerial library, plus waitAvailable() so that
+//  drivers can block until the module responds instead of spinning on available().
+#ifndef UNABIZ_HOST_SERIALSTREAM_H
+#define UNABIZ_HOST_SERIALSTREAM_H
+
+#include "Arduino.h"
+
+class SerialStream: public Stream
+{
+public:
+  virtual ~SerialStream() {}
+  virtual void begin(long speed) = 0;
+  virtual bool listen() { return false; }
+  virtual void end() {}
+  //  Wait up to timeout milliseconds for data.  Returns true if data is available.
+  //  By default only checks, for ports whose data arrives while the caller polls millis().
+  virtual bool waitAvailable(unsigned long timeout) { return available() > 0; }
+};
+
+#endif  //  UNABIZ_HOST_SERIALSTREAM_H
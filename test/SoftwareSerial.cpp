@@ -0,0 +1,87 @@
+//  SoftwareSerial for building the library natively on Linux / Mac without Arduino.
+#include <vector>
+#include "SoftwareSerial.h"
+
+SoftwareSerial *SoftwareSerial::activeObject = 0;
+
+struct Connection { uint8_t receivePin, transmitPin; SerialStream *device; };
+static std::vector<Connection> connections;  //  Devices connected with connect().
+
+void SoftwareSerial::connect(uint8_t receivePin, uint8_t transmitPin, SerialStream *device) {
+  for (size_t i = 0; i < connections.size(); i++) {
+    if (connections[i].receivePin != receivePin || connections[i].transmitPin != transmitPin) continue;
+    connections[i].device = device;
+    return;
+  }
+  Connection conn = { receivePin, transmitPin, device };
+  connections.push_back(conn);
+}
+
+SoftwareSerial::SoftwareSerial(uint8_t receivePin0, uint8_t transmitPin0, bool inverse_logic):
+  receivePin(receivePin0),
+  transmitPin(transmitPin0),
+  speed(0),
+  device(0) {}
+
+SoftwareSerial::~SoftwareSerial() {
+  end();
+}
+
+void SoftwareSerial::begin(long speed0) {
+  speed = speed0;
+  device = 0;
+  for (size_t i = 0; i < connections.size(); i++)
+    if (connections[i].receivePin == receivePin && connections[i].transmitPin == transmitPin)
+      device = connections[i].device;
+  if (device) device->begin(speed);
+  listen();
+}
+
+bool SoftwareSerial::listen() {
+  //  Set this port as the listening one.  Returns true if it replaces another.
+  if (speed == 0 || activeObject == this) return false;
+  if (activeObject) activeObject->stopListening();
+  activeObject = this;
+  //  Bytes sent by the device while we were not listening are lost, like Arduino.
+  if (device) while (device->available() > 0) device->read();
+  return true;
+}
+
+bool SoftwareSerial::stopListening() {
+  if (activeObject != this) return false;
+  activeObject = 0;
+  return true;
+}
+
+void SoftwareSerial::end() {
+  stopListening();
+}
+
+size_t SoftwareSerial::write(uint8_t byte) {
+  if (speed == 0) {
+    setWriteError();
+    return 0;
+  }
+  if (device) device->write(byte);
+  return 1;
+}
+
+int SoftwareSerial::read() {
+  if (!device || !isListening()) return -1;
+  return device->read();
+}
+
+int SoftwareSerial::peek() {
+  if (!device || !isListening()) return -1;
+  return device->peek();
+}
+
+int SoftwareSerial::available() {
+  if (!device || !isListening()) return 0;
+  return device->available();
+}
+
+void SoftwareSerial::flush() {
+  //  Discard received bytes, like SoftwareSerial before Arduino 1.0 and BeanSoftwareSerial.
+  if (device && isListening()) while (device->available() > 0) device->read();
+}
@@ -0,0 +1,44 @@
+//  SoftwareSerial for building the library natively on Linux / Mac without Arduino.
+//  Same interface as the Arduino SoftwareSerial library.  The pins may be connected
+//  to a simulated device (e.g. ModemEmulator) with connect().  Otherwise written
+//  bytes are dropped and nothing is received.
+#ifndef UNABIZ_HOST_SOFTWARESERIAL_H
+#define UNABIZ_HOST_SOFTWARESERIAL_H
+
+#include "SerialStream.h"
+
+class SoftwareSerial: public SerialStream
+{
+public:
+  SoftwareSerial(uint8_t receivePin, uint8_t transmitPin, bool inverse_logic = false);
+  ~SoftwareSerial();
+  void begin(long speed);
+  bool listen();
+  void end();
+  bool isListening() { return this == activeObject; }
+  bool stopListening();
+  bool overflow() { return false; }
+  int peek();
+
+  virtual size_t write(uint8_t byte);
+  virtual int read();
+  virtual int available();
+  virtual void flush();
+  operator bool() { return true; }
+
+  //  Connect the pins to a simulated device.  Ports using these pins send bytes to
+  //  the device, and receive bytes from the device while listening.  Pass 0 to disconnect.
+  //  The device is told the rate at begin().
+  static void connect(uint8_t receivePin, uint8_t transmitPin, SerialStream *device);
+
+  using Print::write;
+
+private:
+  uint8_t receivePin;
+  uint8_t transmitPin;
+  long speed;  //  Bits per second, 0 if not started.
+  SerialStream *device;  //  Simulated device connected to the pins, found at begin().
+  static SoftwareSerial *activeObject;  //  Only one port may listen at a time, like Arduino.
+};
+
+#endif  //  UNABIZ_HOST_SOFTWARESERIAL_H
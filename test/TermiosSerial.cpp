@@ -0,0 +1,122 @@
+//  SerialStream for a SIGFOX module on a Linux serial device.
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+#include "TermiosSerial.h"
+
+static speed_t toSpeed(long speed) {
+  //  Convert bits per second to the termios constant, or B0 if there is none.
+  switch (speed) {
+    case 1200: return B1200;
+    case 2400: return B2400;
+    case 4800: return B4800;
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    default: return B0;
+  }
+}
+
+bool TermiosSerial::supportsSpeed(long speed) {
+  return toSpeed(speed) != B0;
+}
+
+TermiosSerial::TermiosSerial(const char *path0):
+  fd(-1),
+  speed(0),
+  peekChar(-1) {
+  strncpy(path, path0, sizeof(path) - 1);
+  path[sizeof(path) - 1] = 0;
+}
+
+TermiosSerial::~TermiosSerial() {
+  close();
+}
+
+void TermiosSerial::begin(long speed0) {
+  //  Discard bytes received since the last command, like SoftwareSerial restarting.
+  peekChar = -1;
+  if (fd >= 0) tcflush(fd, TCIFLUSH);
+  if (fd >= 0 && speed == speed0) return;
+  if (!supportsSpeed(speed0)) { close(); setWriteError(); return; }
+  if (fd < 0) {
+    //  Open without waiting for carrier detect, then switch to blocking writes.
+    fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0) { setWriteError(); return; }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+  }
+  struct termios tio;
+  if (tcgetattr(fd, &tio) != 0) { close(); setWriteError(); return; }
+  cfmakeraw(&tio);
+  tio.c_cflag |= CLOCAL | CREAD;
+  tio.c_cc[VMIN] = 0;  //  read() returns at once with whatever has arrived.
+  tio.c_cc[VTIME] = 0;
+  cfsetispeed(&tio, toSpeed(speed0));
+  cfsetospeed(&tio, toSpeed(speed0));
+  if (tcsetattr(fd, TCSANOW, &tio) != 0) { close(); setWriteError(); return; }
+  speed = speed0;
+}
+
+void TermiosSerial::close() {
+  if (fd >= 0) ::close(fd);
+  fd = -1; speed = 0; peekChar = -1;
+}
+
+size_t TermiosSerial::write(uint8_t byte) {
+  return write(&byte, 1);
+}
+
+size_t TermiosSerial::write(const uint8_t *buffer, size_t size) {
+  if (fd < 0) { setWriteError(); return 0; }
+  size_t n = 0;
+  while (n < size) {
+    ssize_t count = ::write(fd, buffer + n, size - n);
+    if (count < 0 && errno == EINTR) continue;
+    if (count <= 0) { setWriteError(); break; }
+    n = n + count;
+  }
+  return n;
+}
+
+int TermiosSerial::read() {
+  if (peekChar >= 0) { int ch = peekChar; peekChar = -1; return ch; }
+  if (fd < 0) return -1;
+  uint8_t ch;
+  if (::read(fd, &ch, 1) != 1) return -1;
+  return ch;
+}
+
+int TermiosSerial::peek() {
+  if (peekChar < 0) peekChar = read();
+  return peekChar;
+}
+
+int TermiosSerial::available() {
+  if (fd < 0) return 0;
+  int count = 0;
+  if (ioctl(fd, FIONREAD, &count) != 0) count = 0;
+  return count + (peekChar >= 0 ? 1 : 0);
+}
+
+void TermiosSerial::flush() {
+  //  Wait for transmission, then discard received bytes.
+  peekChar = -1;
+  if (fd < 0) return;
+  tcdrain(fd);
+  tcflush(fd, TCIFLUSH);
+}
+
+bool TermiosSerial::waitAvailable(unsigned long timeout) {
+  if (available() > 0) return true;
+  if (fd < 0) return false;
+  struct pollfd pfd = { fd, POLLIN, 0 };
+  int result;
+  do { result = poll(&pfd, 1, (int) timeout); } while (result < 0 && errno == EINTR);
+  return result > 0 && (pfd.revents & POLLIN);
+}
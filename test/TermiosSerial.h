@@ -0,0 +1,45 @@
+//  SerialStream for a SIGFOX module on a Linux serial device, e.g. a Wisol module on
+//  a USB UART (/dev/ttyUSB0).  The device is opened raw with VMIN = 0 and VTIME = 0,
+//  so read() never blocks, and waitAvailable() blocks in poll() until data arrives.
+#ifndef UNABIZ_HOST_TERMIOSSERIAL_H
+#define UNABIZ_HOST_TERMIOSSERIAL_H
+
+#include "SerialStream.h"
+
+class TermiosSerial: public SerialStream
+{
+public:
+  TermiosSerial(const char *path);
+  ~TermiosSerial();
+  static bool supportsSpeed(long speed);  //  True if termios can set the rate.
+  //  Open the device on first use and set the speed.  The device stays open across
+  //  end() and begin(), since the drivers restart the port for every command.
+  //  Like SoftwareSerial, bytes received before begin() are discarded.  A rate that
+  //  termios can't set, e.g. 76800, sets the write error and leaves the port closed.
+  virtual void begin(long speed);
+  virtual bool listen() { return fd >= 0; }
+  virtual void end() {}
+  void close();
+
+  virtual size_t write(uint8_t byte);
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  virtual int read();
+  virtual int peek();
+  virtual int available();
+  virtual void flush();  //  Discard received bytes like BeanSoftwareSerial, after transmitting.
+  virtual bool waitAvailable(unsigned long timeout);
+  operator bool() { return fd >= 0; }
+
+  int getFd() const { return fd; }  //  For callers that multiplex many ports, e.g. with epoll.
+  const char *getPath() const { return path; }
+
+  using Print::write;
+
+private:
+  char path[64];
+  int fd;  //  -1 if not open.
+  long speed;  //  Bits per second set on the device.
+  int peekChar;  //  Byte read by peek(), or -1.
+};
+
+#endif  //  UNABIZ_HOST_TERMIOSSERIAL_H
@@ -0,0 +1,17 @@
+//  Program memory (Flash) helpers for building the library natively without Arduino.
+//  There is no separate program memory on Linux / Mac so these map to the normal C functions.
+#ifndef UNABIZ_HOST_PGMSPACE_H
+#define UNABIZ_HOST_PGMSPACE_H
+
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s) (s)
+typedef const char *PGM_P;
+#define strcpy_P strcpy
+#define strlen_P strlen
+#define memcpy_P memcpy
+#define pgm_read_byte(addr) (*(const unsigned char *) (addr))
+#define pgm_read_word(addr) (*(const unsigned short *) (addr))
+
+#endif  //  UNABIZ_HOST_PGMSPACE_H
@@ -0,0 +1,25 @@
+//  Print a capture file written by CaptureWriter, one line per run of bytes sent
+//  to (>>) or received from (<<) the module, like the drivers' echo output.
+//    capdump file.cap
+#include <stdio.h>
+#include <ctype.h>
+#include "Capture.h"
+
+int main(int argc, char **argv) {
+  if (argc != 2) { fprintf(stderr, "usage: %s file.cap\n", argv[0]); return 2; }
+  std::vector<CaptureRecord> records;
+  if (!loadCapture(argv[1], records)) { fprintf(stderr, "%s: not a capture file\n", argv[1]); return 1; }
+  for (size_t i = 0; i < records.size();) {
+    const CaptureRecord &first = records[i];
+    printf("%12.3f ms  port %u  %s ", first.time / 1000.0, first.port, first.transmit ? ">>" : "<<");
+    String hex, text;
+    for (; i < records.size() && records[i].port == first.port && records[i].transmit == first.transmit; i++) {
+      char buf[4];
+      snprintf(buf, sizeof(buf), "%02x ", records[i].ch);
+      hex.concat(buf);
+      text.concat(isprint(records[i].ch) ? (char) records[i].ch : '.');
+    }
+    printf("%s |%s|\n", hex.c_str(), text.c_str());
+  }
+  return 0;
+}
@@ -0,0 +1,231 @@
+//  Fleet simulator for capacity planning.  Runs thousands of simulated devices, each
+//  a Message + Wisol or Radiocrafts transceiver wired to its own simulated module
+//  (ModemEmulator.cpp) and its own VirtualClock, running the sensor loop of
+//  examples/send-altitude-structured.  Devices are stepped one loop() at a time by
+//  a work-stealing thread pool.  Writes the resulting uplink stream, ordered by
+//  time of arrival, with air time per RCZ, and reports simulated devices per core
+//  per second.  Run without Arduino.
+//    fleetsim [-n devices] [-t threads] [-h hours] [-k wisol|radiocrafts|mixed] [-o uplinks.csv]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include "SIGFOX.h"
+#include "Clock.h"
+#include "ModemEmulator.h"
+
+//  Approximate time to transmit 3 repetitions of a 12-byte frame in each RCZ:
+//  100 bps in RCZ1 and RCZ3 (plus listen before talk), 600 bps in RCZ2 and RCZ4.
+struct ZoneTiming { Country country; int zone; uint64_t uplinkTime; };
+static const ZoneTiming zones[] = {
+  { COUNTRY_FR, 1, 6240000 },
+  { COUNTRY_US, 2, 1040000 },
+  { COUNTRY_JP, 3, 6480000 },
+  { COUNTRY_SG, 4, 1040000 },
+};
+static const int zoneCount = sizeof(zones) / sizeof(zones[0]);
+
+struct Uplink { uint64_t time; unsigned device; String payload; };
+
+class Device
+{
+public:
+  Device(unsigned id0, const ZoneTiming &zone0, bool radiocrafts, uint64_t end0):
+    id(id0), zone(zone0), end(end0), random(id0) {
+    ModemConfig config;
+    config.seed = id;
+    config.uplinkTime = zone.uplinkTime;
+    char hex[9];
+    snprintf(hex, sizeof(hex), "%08X", id);
+    strcpy(sigfoxId, hex);
+    config.id = sigfoxId;
+    //  Start devices at random times in the first send interval.
+    clock.advance(std::uniform_int_distribution<uint64_t>(0, (uint64_t) SEND_DELAY * 1000)(random));
+    if (radiocrafts) {
+      modem = new RadiocraftsEmulator(config);
+      radiocraftsTransceiver = new Radiocrafts(zone.country, false, "", false, modem);
+    } else {
+      modem = new WisolEmulator(config);
+      wisolTransceiver = new Wisol(zone.country, false, "", false, modem);
+    }
+    modem->uplinkHandler = onUplink;
+    modem->uplinkContext = this;
+  }
+
+  bool step() {
+    //  Run setup() or one loop() on this device's clock.  Returns false when done.
+    setClock(&clock);
+    if (!started) {
+      started = true;
+      if (!(wisolTransceiver ? wisolTransceiver->begin() : radiocraftsTransceiver->begin())) failed++;
+    } else loop();
+    loops++;
+    setClock(0);
+    return clock.now() < end;
+  }
+
+  unsigned id;
+  const ZoneTiming &zone;
+  unsigned long loops = 0, failed = 0;
+  std::vector<Uplink> uplinks;
+
+private:
+  void loop() {
+    //  Same as examples/send-altitude-structured, with a simulated BME280.
+    temperature += std::normal_distribution<float>(0, 0.2f)(random);
+    humidity = std::min(100.0f, std::max(0.0f, humidity + std::normal_distribution<float>(0, 0.5f)(random)));
+    altitude += std::normal_distribution<float>(0, 0.1f)(random);
+    if (wisolTransceiver) {
+      float moduleTemp; wisolTransceiver->getTemperature(moduleTemp);
+      Message msg(*wisolTransceiver);
+      send(msg);
+    } else {
+      int moduleTemp; radiocraftsTransceiver->getTemperature(moduleTemp);
+      Message msg(*radiocraftsTransceiver);
+      send(msg);
+    }
+    delay(SEND_DELAY);
+  }
+
+  void send(Message &msg) {
+    //  Total 12 bytes out of 12 bytes used.
+    msg.addField("tmp", temperature);
+    msg.addField("hmd", humidity);
+    msg.addField("alt", altitude);
+    if (!msg.send()) failed++;
+  }
+
+  static void onUplink(void *context, uint64_t time, const String &payload) {
+    Device *device = (Device *) context;
+    Uplink uplink = { time, device->id, payload };
+    device->uplinks.push_back(uplink);
+  }
+
+  const uint64_t end;  //  Stop when the clock passes this time (microseconds).
+  VirtualClock clock;
+  std::mt19937 random;
+  bool started = false;
+  char sigfoxId[9];
+  ModemEmulator *modem = 0;
+  Wisol *wisolTransceiver = 0;
+  Radiocrafts *radiocraftsTransceiver = 0;
+  float temperature = 28.5f, humidity = 70.0f, altitude = 15.0f;
+};
+
+//  Work-stealing pool: each worker runs devices from the back of its own queue and
+//  steals from the front of other queues when its own is empty.
+class Pool
+{
+public:
+  Pool(std::vector<Device *> &devices0, unsigned threads):
+    devices(devices0), queues(threads), remaining(devices0.size()) {
+    for (size_t i = 0; i < devices.size(); i++) queues[i % threads].tasks.push_back((unsigned) i);
+  }
+
+  void run() {
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < queues.size(); i++) workers.push_back(std::thread(&Pool::work, this, i));
+    for (size_t i = 0; i < workers.size(); i++) workers[i].join();
+  }
+
+  std::atomic<unsigned long> steals{0};
+
+private:
+  struct Queue { std::mutex lock; std::deque<unsigned> tasks; };
+
+  bool take(unsigned self, unsigned &task) {
+    //  Take from our own queue, else steal from the others.
+    for (unsigned n = 0; n < queues.size(); n++) {
+      Queue &q = queues[(self + n) % queues.size()];
+      std::lock_guard<std::mutex> guard(q.lock);
+      if (q.tasks.empty()) continue;
+      if (n == 0) { task = q.tasks.back(); q.tasks.pop_back(); }
+      else { task = q.tasks.front(); q.tasks.pop_front(); steals++; }
+      return true;
+    }
+    return false;
+  }
+
+  void work(unsigned self) {
+    while (remaining > 0) {
+      unsigned task;
+      if (!take(self, task)) { std::this_thread::yield(); continue; }  //  Others are busy with the last devices.
+      if (devices[task]->step()) {
+        std::lock_guard<std::mutex> guard(queues[self].lock);
+        queues[self].tasks.push_front(task);  //  Run the other devices before this one again.
+      } else remaining--;
+    }
+  }
+
+  std::vector<Device *> &devices;
+  std::vector<Queue> queues;
+  std::atomic<size_t> remaining;
+};
+
+int main(int argc, char **argv) {
+  unsigned deviceCount = 2000, threads = std::thread::hardware_concurrency();
+  double hours = 24;
+  const char *kind = "mixed", *outPath = 0;
+  int opt;
+  while ((opt = getopt(argc, argv, "n:t:h:k:o:")) != -1) {
+    switch (opt) {
+      case 'n': deviceCount = (unsigned) atoi(optarg); break;
+      case 't': threads = (unsigned) atoi(optarg); break;
+      case 'h': hours = atof(optarg); break;
+      case 'k': kind = optarg; break;
+      case 'o': outPath = optarg; break;
+      default:
+        fprintf(stderr, "usage: %s [-n devices] [-t threads] [-h hours] [-k wisol|radiocrafts|mixed] [-o uplinks.csv]\n", argv[0]);
+        return 2;
+    }
+  }
+  if (threads == 0) threads = 1;
+  const uint64_t end = (uint64_t) (hours * 3600e6);
+  std::vector<Device *> devices;
+  for (unsigned i = 0; i < deviceCount; i++) {
+    const bool radiocrafts = !strcmp(kind, "radiocrafts") || (!strcmp(kind, "mixed") && i % 2 == 1);
+    devices.push_back(new Device(i, zones[(i / 2) % zoneCount], radiocrafts, end));
+  }
+
+  Pool pool(devices, threads);
+  auto wallStart = std::chrono::steady_clock::now();
+  pool.run();
+  const double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+
+  //  Merge the uplink streams in order of arrival.
+  std::vector<Uplink> uplinks;
+  unsigned long loops = 0, failed = 0, zoneUplinks[zoneCount + 1] = { 0 };
+  for (size_t i = 0; i < devices.size(); i++) {
+    loops += devices[i]->loops;
+    failed += devices[i]->failed;
+    zoneUplinks[devices[i]->zone.zone] += devices[i]->uplinks.size();
+    uplinks.insert(uplinks.end(), devices[i]->uplinks.begin(), devices[i]->uplinks.end());
+  }
+  std::sort(uplinks.begin(), uplinks.end(),
+            [](const Uplink &a, const Uplink &b) { return a.time < b.time || (a.time == b.time && a.device < b.device); });
+  if (outPath) {
+    FILE *out = fopen(outPath, "w");
+    if (!out) { perror(outPath); return 1; }
+    fprintf(out, "time_ms,device,rcz,payload\n");
+    for (size_t i = 0; i < uplinks.size(); i++)
+      fprintf(out, "%llu,%08X,%d,%s\n", (unsigned long long) (uplinks[i].time / 1000), uplinks[i].device,
+              devices[uplinks[i].device]->zone.zone, uplinks[i].payload.c_str());
+    fclose(out);
+  }
+
+  printf("%u devices, %.1f simulated hours, %u threads, %.2f s wall-clock\n", deviceCount, hours, threads, wall);
+  printf("loops=%lu failed=%lu uplinks=%lu (RCZ1 %lu, RCZ2 %lu, RCZ3 %lu, RCZ4 %lu), %.2f uplinks/s simulated\n",
+         loops, failed, (unsigned long) uplinks.size(), zoneUplinks[1], zoneUplinks[2], zoneUplinks[3], zoneUplinks[4],
+         uplinks.size() / (hours * 3600));
+  printf("%.0f device-loops per core per second, %.1f simulated device-days per core per second, steals=%lu\n",
+         loops / wall / threads, deviceCount * hours / 24 / wall / threads, (unsigned long) pool.steals);
+  return failed > 0 ? 1 : 0;
+}
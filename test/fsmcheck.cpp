@@ -0,0 +1,31 @@
+//  Compile-time checks of the Fsm transition table in examples/multiple_inputs.
+//  Built only with -fsyntax-only by ctest: it must compile as is, and fail to
+//  compile with FSM_BAD_OUT_OF_RANGE or FSM_BAD_DUPLICATE_ID defined.
+#include "Fsm.h"
+
+static constexpr State idle(0, 0, 0, 0);
+static constexpr State busy(1, 0, 0, 0);
+#ifdef FSM_BAD_DUPLICATE_ID
+static constexpr State done(1, 0, 0, 0);  //  Same number as busy.
+#else
+static constexpr State done(2, 0, 0, 0);
+#endif
+
+static constexpr Transition rows[] = {
+  { &idle, &busy, 0, 0 },
+  { &busy, &done, 1, 0 },
+#ifdef FSM_BAD_OUT_OF_RANGE
+  { &done, &idle, 2, 0 },  //  Event 2 is past the 2 events of the table.
+#endif
+};
+
+static constexpr TimedTransition timedRows[] = {
+  { &done, &idle, 1000, 0 },
+};
+
+static constexpr FsmTable<3, 2> table = fsm_table<3, 2>(rows);
+static constexpr FsmTable<3, 2> timedTable = fsm_table<3, 2>(rows, timedRows);
+
+int main() {
+  return table.row[0] + timedTable.timed[2];
+}
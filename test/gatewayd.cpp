@@ -0,0 +1,274 @@
+//  Gateway daemon that sends SIGFOX messages through many Wisol modules on Linux
+//  serial devices from a single thread.  All ports (and stdin) are multiplexed
+//  through one epoll loop, and each module runs the same command sequence as
+//  Wisol::sendMessage() as a non-blocking state machine, using the AT commands
+//  in Wisol.h.  Payloads come from a shared queue and go to the next module whose
+//  duty cycle allows it to send.  Per-port send latency and throughput are reported.
+//    gatewayd [-z zone] [-i interval_ms] [-n count] [-d] [-r report_s] device...
+//  Payloads are read from stdin as hex, one per line, unless -n generates them.
+//  -i overrides the SEND_DELAY duty cycle per module, e.g. for load testing
+//  against modememu.  -d requests a downlink for every message.
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <deque>
+#include <vector>
+#include "SIGFOX.h"
+#include "TermiosSerial.h"
+
+static const unsigned long retryDelay = 1000;  //  Milliseconds before a failed module is used again.
+static const int maxAttempts = 3;  //  Drop a payload after failing this many times.
+
+struct Work {
+  String payload;
+  int attempts;  //  Number of failed sends so far.
+};
+
+struct Module {
+  enum State { IDLE, PRESEND, PRESEND2, SENDING, DOWNLINK };
+  TermiosSerial *port;
+  State state;
+  String line;  //  Response line received so far.
+  Work work;  //  Payload being sent.
+  unsigned long deadline;  //  Time (ms) when the current command times out.
+  unsigned long nextSend;  //  Time (ms) when the duty cycle allows the next send.
+  unsigned long sendStart;  //  Time (us) when AT$SF was written.
+  unsigned long sent, failed, downlinks;
+  unsigned long latencySum, latencyMax;  //  Microseconds from AT$SF to OK (or downlink).
+};
+
+static const ZoneProfile *profile = getZoneProfile(4);
+static unsigned long sendInterval = SEND_DELAY;
+static bool downlink = false;
+static std::vector<Module> modules;
+static std::deque<Work> queue;  //  Payloads waiting for a module.
+static unsigned long dropped = 0;  //  Payloads that failed maxAttempts times.
+
+static bool command(Module &m, const String &cmd, Module::State state, unsigned long timeout) {
+  //  Write the AT command and wait for the response in the given state.
+  String buffer = cmd + CMD_END;
+  if (m.port->write((const uint8_t *) buffer.c_str(), buffer.length()) != buffer.length()) return false;
+  m.state = state;
+  m.line = "";
+  m.deadline = millis() + timeout;
+  return true;
+}
+
+static void finish(Module &m, bool ok) {
+  //  End the send.  Failed payloads go back to the front of the queue.
+  const unsigned long now = millis();
+  m.state = Module::IDLE;
+  if (!ok) {
+    m.failed++;
+    if (++m.work.attempts < maxAttempts) queue.push_front(m.work);
+    else { dropped++; fprintf(stderr, "dropped payload %s\n", m.work.payload.c_str()); }
+    m.nextSend = now + retryDelay;
+    return;
+  }
+  const unsigned long latency = micros() - m.sendStart;
+  m.sent++;
+  m.latencySum += latency;
+  if (latency > m.latencyMax) m.latencyMax = latency;
+  m.nextSend = m.sendStart / 1000 + sendInterval;
+}
+
+static void sendMessage(Module &m) {
+  m.sendStart = micros();
+  String cmd = String(CMD_SEND_MESSAGE) + m.work.payload;
+  if (downlink) cmd.concat(CMD_SEND_MESSAGE_RESPONSE);
+  if (!command(m, cmd, Module::SENDING, WISOL_COMMAND_TIMEOUT)) finish(m, false);
+}
+
+static void handleLine(Module &m, const String &line) {
+  //  Handle a response line according to the command that was sent.
+  if (line == "ERROR") { finish(m, false); return; }
+  switch (m.state) {
+    case Module::PRESEND:
+      if (profile->channelReset) {
+        //  Parse the returned X,Y like Wisol::setOutputPower().
+        int x = line.charAt(0) - '0';
+        int y = line.charAt(2) - '0';
+        if (x == 0 || y < 3) {
+          if (!command(m, CMD_PRESEND2, Module::PRESEND2, COMMAND_TIMEOUT)) finish(m, false);
+          return;
+        }
+      }
+      sendMessage(m);
+      return;
+    case Module::PRESEND2:
+      sendMessage(m);
+      return;
+    case Module::SENDING:
+      if (line != "OK") { finish(m, false); return; }
+      if (downlink) { m.state = Module::DOWNLINK; return; }
+      finish(m, true);
+      return;
+    case Module::DOWNLINK:
+      if (!line.startsWith("RX=")) { finish(m, false); return; }
+      m.downlinks++;
+      finish(m, true);
+      return;
+    default:
+      return;  //  Unexpected output while idle.
+  }
+}
+
+static void receive(Module &m) {
+  //  Read all available bytes from the module.  Lines end with '\r'.
+  uint8_t buf[256];
+  for (;;) {
+    ssize_t count = read(m.port->getFd(), buf, sizeof(buf));
+    if (count <= 0) return;
+    for (ssize_t i = 0; i < count; i++) {
+      if (buf[i] == '\n') continue;
+      if (buf[i] != '\r') { m.line.concat((char) buf[i]); continue; }
+      String line = m.line;
+      m.line = "";
+      handleLine(m, line);
+    }
+  }
+}
+
+static void dispatch() {
+  //  Start sending on idle modules whose duty cycle allows it.
+  const unsigned long now = millis();
+  for (size_t i = 0; i < modules.size() && !queue.empty(); i++) {
+    Module &m = modules[i];
+    if (m.state != Module::IDLE || (long) (now - m.nextSend) < 0) continue;
+    m.work = queue.front();
+    queue.pop_front();
+    //  Set the output power for the zone, like Wisol::setOutputPower().
+    const char *cmd = profile->channelReset ? CMD_PRESEND : profile->outputPower;
+    if (!command(m, cmd, Module::PRESEND, COMMAND_TIMEOUT)) finish(m, false);
+  }
+}
+
+static void addPayload(const char *buf, size_t len, String &input) {
+  //  Queue the complete lines in buf.  input holds the incomplete line.
+  for (size_t i = 0; i < len; i++) {
+    if (buf[i] != '\n' && buf[i] != '\r') { input.concat(buf[i]); continue; }
+    input.trim();
+    Work work = { input, 0 };
+    if (input.length() > 0) queue.push_back(work);
+    input = "";
+  }
+}
+
+static int nextTimeout(unsigned long reportTime) {
+  //  Milliseconds until the next command timeout, duty cycle expiry or report.
+  const unsigned long now = millis();
+  long wait = (long) (reportTime - now);
+  for (size_t i = 0; i < modules.size(); i++) {
+    const Module &m = modules[i];
+    long t = -1;
+    if (m.state != Module::IDLE) t = (long) (m.deadline - now);
+    else if (!queue.empty()) t = (long) (m.nextSend - now);
+    if (t >= 0 && t < wait) wait = t;
+    if (t < 0 && (m.state != Module::IDLE || !queue.empty())) wait = 0;
+  }
+  return wait < 0 ? 0 : (int) wait;
+}
+
+static void report(unsigned long start) {
+  const double seconds = (millis() - start) / 1000.0;
+  unsigned long total = 0;
+  for (size_t i = 0; i < modules.size(); i++) {
+    const Module &m = modules[i];
+    total += m.sent;
+    fprintf(stderr, "%-16s sent=%lu failed=%lu downlinks=%lu latency avg=%.1f max=%.1f ms, %.2f sends/min\n",
+            m.port->getPath(), m.sent, m.failed, m.downlinks,
+            m.sent ? m.latencySum / 1000.0 / m.sent : 0.0, m.latencyMax / 1000.0,
+            seconds > 0 ? m.sent * 60 / seconds : 0.0);
+  }
+  fprintf(stderr, "total sent=%lu queued=%u dropped=%lu in %.1f s, %.2f sends/s\n",
+          total, (unsigned) queue.size(), dropped, seconds, seconds > 0 ? total / seconds : 0.0);
+}
+
+int main(int argc, char **argv) {
+  long count = -1; int reportSeconds = 60, opt;
+  while ((opt = getopt(argc, argv, "z:i:n:dr:")) != -1) {
+    switch (opt) {
+      case 'z':
+        profile = getZoneProfile(atoi(optarg));
+        if (!profile) { fprintf(stderr, "%s: unknown zone %s\n", argv[0], optarg); return 2; }
+        break;
+      case 'i': sendInterval = strtoul(optarg, 0, 10); break;
+      case 'n': count = atol(optarg); break;
+      case 'd': downlink = true; break;
+      case 'r': reportSeconds = atoi(optarg); break;
+      default:
+        fprintf(stderr, "usage: %s [-z zone] [-i interval_ms] [-n count] [-d] [-r report_s] device...\n", argv[0]);
+        return 2;
+    }
+  }
+  if (optind >= argc) { fprintf(stderr, "%s: no devices\n", argv[0]); return 2; }
+
+  const int epollFd = epoll_create1(0);
+  modules.resize(argc - optind);
+  for (size_t i = 0; i < modules.size(); i++) {
+    Module &m = modules[i];
+    m = Module();
+    m.port = new TermiosSerial(argv[optind + i]);
+    m.port->begin(9600);
+    if (!*m.port) { perror(argv[optind + i]); return 1; }
+    fcntl(m.port->getFd(), F_SETFL, fcntl(m.port->getFd(), F_GETFL) | O_NONBLOCK);
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.u32 = (uint32_t) i;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, m.port->getFd(), &ev);
+  }
+  //  Payloads from stdin, or generated.
+  bool inputDone = count >= 0;
+  for (long i = 0; i < count; i++) {
+    char hex[25];
+    snprintf(hex, sizeof(hex), "%024lx", (unsigned long) i);
+    Work work = { hex, 0 };
+    queue.push_back(work);
+  }
+  String input;
+  if (!inputDone) {
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.u32 = UINT32_MAX;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, 0, &ev) == 0) fcntl(0, F_SETFL, fcntl(0, F_GETFL) | O_NONBLOCK);
+    else {
+      //  Regular files can't be polled: read all payloads now.
+      char buf[256];
+      while (fgets(buf, sizeof(buf), stdin)) addPayload(buf, strlen(buf), input);
+      addPayload("\n", 1, input);
+      inputDone = true;
+    }
+  }
+
+  const unsigned long start = millis();
+  unsigned long reportTime = start + reportSeconds * 1000UL;
+  for (;;) {
+    dispatch();
+    bool busy = !queue.empty();
+    for (size_t i = 0; i < modules.size(); i++) if (modules[i].state != Module::IDLE) busy = true;
+    if (inputDone && !busy) break;
+
+    struct epoll_event events[64];
+    int n = epoll_wait(epollFd, events, 64, nextTimeout(reportTime));
+    if (n < 0 && errno != EINTR) { perror("epoll_wait"); return 1; }
+    for (int e = 0; e < n; e++) {
+      if (events[e].data.u32 != UINT32_MAX) { receive(modules[events[e].data.u32]); continue; }
+      //  Read payloads from stdin, one per line.
+      char buf[256];
+      ssize_t len = read(0, buf, sizeof(buf));
+      if (len <= 0) { if (len == 0 || errno != EAGAIN) { inputDone = true; epoll_ctl(epollFd, EPOLL_CTL_DEL, 0, 0); } continue; }
+      addPayload(buf, len, input);
+    }
+    //  Fail commands that timed out.
+    const unsigned long now = millis();
+    for (size_t i = 0; i < modules.size(); i++)
+      if (modules[i].state != Module::IDLE && (long) (now - modules[i].deadline) >= 0) finish(modules[i], false);
+    if ((long) (now - reportTime) >= 0) { report(start); reportTime = now + reportSeconds * 1000UL; }
+  }
+  report(start);
+  return 0;
+}
@@ -0,0 +1,85 @@
+//  Microbenchmark for the hex payload decoder in Hex.cpp.  Compares the
+//  vectorised hexToBytesBulk against the per-character hexDigitToDecimal
+//  routine used by the transceiver drivers.  Run without Arduino.
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include "../Hex.h"
+
+static const size_t payloadDigits = 24;  //  12 bytes per SIGFOX message.
+static const size_t payloadCount = 100000;
+static const int rounds = 20;
+
+static uint8_t hexDigitToDecimal(char ch) {
+  //  Same as Wisol::hexDigitToDecimal and Radiocrafts::hexDigitToDecimal.
+  if (ch >= '0' && ch <= '9') return (uint8_t) ch - '0';
+  if (ch >= 'a' && ch <= 'z') return (uint8_t) ch - 'a' + 10;
+  if (ch >= 'A' && ch <= 'Z') return (uint8_t) ch - 'A' + 10;
+  return 0;
+}
+
+static void decodePerChar(const char *hex, size_t count, uint8_t *out) {
+  //  Convert the payloads one nibble at a time, the way the drivers do.
+  for (size_t i = 0; i < count * payloadDigits; i = i + 2)
+    out[i / 2] = hexDigitToDecimal(hex[i]) * 16 + hexDigitToDecimal(hex[i + 1]);
+}
+
+template <typename F> static double timeIt(F f) {
+  //  Return the best time in nanoseconds per payload over all rounds.
+  double best = 1e30;
+  for (int r = 0; r < rounds; r++) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count() / payloadCount;
+    if (ns < best) best = ns;
+  }
+  return best;
+}
+
+int main() {
+  //  Generate random payloads in mixed case.
+  static const char digits[] = "0123456789abcdefABCDEF";
+  std::vector<char> hex(payloadCount * payloadDigits);
+  srand(1);
+  for (size_t i = 0; i < hex.size(); i++) hex[i] = digits[rand() % 22];
+  std::vector<uint8_t> expected(hex.size() / 2), actual(hex.size() / 2), invalid(payloadCount);
+
+  //  Check that all decoders agree.
+  decodePerChar(hex.data(), payloadCount, expected.data());
+  if (hexToBytesBulk(hex.data(), payloadDigits, payloadCount, actual.data(), invalid.data()) != 0
+      || memcmp(expected.data(), actual.data(), expected.size()) != 0) {
+    puts("hexToBytesBulk: FAILED to match per-char decoder"); return 1;
+  }
+  if (!hexToBytesScalar(hex.data(), hex.size(), actual.data())
+      || memcmp(expected.data(), actual.data(), expected.size()) != 0) {
+    puts("hexToBytesScalar: FAILED to match per-char decoder"); return 1;
+  }
+  //  Check that invalid digits are flagged for the right payloads only.
+  std::vector<char> bad(hex);
+  bad[5 * payloadDigits + 23] = 'g'; bad[77 * payloadDigits] = ' '; bad[78 * payloadDigits + 16] = '\xb3';
+  size_t badCount = hexToBytesBulk(bad.data(), payloadDigits, payloadCount, actual.data(), invalid.data());
+  if (badCount != 3 || !invalid[5] || !invalid[77] || !invalid[78] || invalid[6]) {
+    printf("hexToBytesBulk: FAILED to flag invalid payloads, found %u\n", (unsigned) badCount); return 1;
+  }
+
+  double perChar = timeIt([&]() { decodePerChar(hex.data(), payloadCount, actual.data()); });
+  double scalar = timeIt([&]() { hexToBytesScalar(hex.data(), hex.size(), actual.data()); });
+  double single = timeIt([&]() {
+    for (size_t i = 0; i < payloadCount; i++)
+      hexToBytes(hex.data() + i * payloadDigits, payloadDigits, actual.data() + i * payloadDigits / 2);
+  });
+  double bulk = timeIt([&]() {
+    hexToBytesBulk(hex.data(), payloadDigits, payloadCount, actual.data(), invalid.data());
+  });
+  printf("%u payloads of %u hex digits, best of %d rounds (ns per payload):\n",
+         (unsigned) payloadCount, (unsigned) payloadDigits, rounds);
+  printf("  per-char hexDigitToDecimal: %7.2f\n", perChar);
+  printf("  hexToBytesScalar:           %7.2f\n", scalar);
+  printf("  hexToBytes per payload:     %7.2f  (%.1fx)\n", single, perChar / single);
+  printf("  hexToBytesBulk:             %7.2f  (%.1fx)\n", bulk, perChar / bulk);
+  return 0;
+}
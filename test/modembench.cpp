@@ -0,0 +1,70 @@
+//  Benchmark the Wisol and Radiocrafts drivers end to end against the simulated
+//  modules in ModemEmulator.cpp, on simulated time.  Reports the simulated time
+//  per send (dominated by the drivers' pacing and timeouts) and the wall-clock
+//  throughput of the host build.  Run without Arduino.
+#include <stdio.h>
+#include <chrono>
+#include "SIGFOX.h"
+#include "Clock.h"
+#include "ModemEmulator.h"
+
+static const int sendCount = 200;
+
+template <typename Transceiver> static bool bench(const char *name, Transceiver &transceiver,
+                                                  ModemEmulator &modem, VirtualClock &clock) {
+  //  Send messages back to back, skipping the SEND_DELAY between them.
+  const uint64_t beginStart = clock.now();
+  if (!transceiver.begin()) { printf("%s: FAILED to begin\n", name); return false; }
+  printf("%-12s begin() %.1f ms simulated\n", name, (clock.now() - beginStart) / 1000.0);
+  uint64_t simTime = 0; int failed = 0;
+  auto wallStart = std::chrono::steady_clock::now();
+  for (int i = 0; i < sendCount; i++) {
+    clock.advance((uint64_t) SEND_DELAY * 1000);
+    const uint64_t start = clock.now();
+    if (!transceiver.sendMessage("0102030405060708090a0b0c")) failed++;
+    simTime += clock.now() - start;
+  }
+  double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wallStart).count();
+  printf("%-12s sent=%d failed=%d uplinks=%lu dropped=%lu  %.1f ms simulated per send, "
+         "%.0f sends per wall-clock second\n", name, sendCount - failed, failed, modem.uplinks,
+         modem.dropped, simTime / 1000.0 / sendCount, sendCount / (wallMs / 1000));
+  return true;
+}
+
+static void benchBinary(Radiocrafts &radiocrafts, VirtualClock &clock) {
+  //  Compare the wall-clock (CPU) time per Radiocrafts transaction when the payload is
+  //  given as hex digits and when it is given as bytes.  Both go to the module as bytes.
+  static const uint8_t payload[] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12 };
+  double wallUs[2];
+  for (int binary = 0; binary < 2; binary++) {
+    int failed = 0;
+    auto wallStart = std::chrono::steady_clock::now();
+    for (int i = 0; i < sendCount; i++) {
+      clock.advance((uint64_t) SEND_DELAY * 1000);
+      int temperature;
+      if (!radiocrafts.getTemperature(temperature)) failed++;
+      if (!(binary ? radiocrafts.sendBytes(payload, sizeof(payload))
+                   : radiocrafts.sendMessage("0102030405060708090a0b0c"))) failed++;
+    }
+    wallUs[binary] = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - wallStart).count() / sendCount;
+    if (failed > 0) printf("Radiocrafts %s: failed=%d\n", binary ? "bytes" : "hex", failed);
+  }
+  printf("Radiocrafts   hex %.2f us, bytes %.2f us per transaction, %.2f us saved\n",
+         wallUs[0], wallUs[1], wallUs[0] - wallUs[1]);
+}
+
+int main() {
+  static VirtualClock clock;
+  setClock(&clock);
+  ModemConfig config;
+  static WisolEmulator wisolModem(config);
+  static RadiocraftsEmulator radiocraftsModem(config);
+  SoftwareSerial::connect(WISOL_RX, WISOL_TX, &wisolModem);
+  SoftwareSerial::connect(10, 11, &radiocraftsModem);
+  static Wisol wisol(COUNTRY_SG, false, "", false);
+  static Radiocrafts radiocrafts(COUNTRY_SG, false, "", false, 10, 11);
+  if (!bench("Wisol", wisol, wisolModem, clock)) return 1;
+  if (!bench("Radiocrafts", radiocrafts, radiocraftsModem, clock)) return 1;
+  benchBinary(radiocrafts, clock);
+  return 0;
+}
@@ -0,0 +1,46 @@
+//  Serve a simulated SIGFOX module over a Linux pseudo-terminal, so that programs
+//  which open a serial port (e.g. minicom, or the library built with a serial
+//  backend) can talk to it like a USB serial adapter.  Prints the pty path, then
+//  serves until killed.
+//    modememu [-r] [-l latency_ms] [-j jitter_ms] [-d drop_rate] [-u uplink_ms] [-w downlink_hex] [-s seed]
+//  -r emulates the Radiocrafts module instead of Wisol.
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "ModemEmulator.h"
+
+int main(int argc, char **argv) {
+  ModemConfig config;
+  bool radiocrafts = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "rl:j:d:u:w:s:")) != -1) {
+    switch (opt) {
+      case 'r': radiocrafts = true; break;
+      case 'l': config.latency = strtoull(optarg, 0, 10) * 1000; break;
+      case 'j': config.jitter = strtoull(optarg, 0, 10) * 1000; break;
+      case 'd': config.dropRate = atof(optarg); break;
+      case 'u': config.uplinkTime = strtoull(optarg, 0, 10) * 1000; break;
+      case 'w': config.downlink = optarg; break;
+      case 's': config.seed = (unsigned) atoi(optarg); break;
+      default:
+        fprintf(stderr, "usage: %s [-r] [-l latency_ms] [-j jitter_ms] [-d drop_rate] "
+                "[-u uplink_ms] [-w downlink_hex] [-s seed]\n", argv[0]);
+        return 2;
+    }
+  }
+  WisolEmulator wisol(config);
+  RadiocraftsEmulator rc(config);
+  ModemEmulator &modem = radiocrafts ? (ModemEmulator &) rc : (ModemEmulator &) wisol;
+  const char *path = modem.openPty();
+  if (!path) { perror("modememu: openpty"); return 1; }
+  printf("%s emulator on %s\n", radiocrafts ? "Radiocrafts" : "Wisol", path);
+  fflush(stdout);
+  for (unsigned long lastCommands = 0;;) {
+    modem.servePty(1000);
+    if (modem.commands == lastCommands) continue;
+    lastCommands = modem.commands;
+    printf("commands=%lu uplinks=%lu downlinks=%lu dropped=%lu last=%s\n", modem.commands,
+           modem.uplinks, modem.downlinks, modem.dropped, modem.lastUplink.c_str());
+    fflush(stdout);
+  }
+}
@@ -0,0 +1,36 @@
+//  Send a SIGFOX message through a Wisol or Radiocrafts module on a Linux serial
+//  device, e.g. a USB UART on a gateway, or a pty served by modememu.
+//    sendserial [-r] [-d] device payload_hex
+//  -r for Radiocrafts instead of Wisol, -d to wait for a downlink (Wisol only).
+#include <stdio.h>
+#include <unistd.h>
+#include "SIGFOX.h"
+#include "TermiosSerial.h"
+
+int main(int argc, char **argv) {
+  bool radiocrafts = false, downlink = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "rd")) != -1) {
+    if (opt == 'r') radiocrafts = true;
+    else if (opt == 'd') downlink = true;
+    else { fprintf(stderr, "usage: %s [-r] [-d] device payload_hex\n", argv[0]); return 2; }
+  }
+  if (argc - optind != 2) { fprintf(stderr, "usage: %s [-r] [-d] device payload_hex\n", argv[0]); return 2; }
+  TermiosSerial port(argv[optind]);
+  const String payload = argv[optind + 1];
+  bool ok;
+  if (radiocrafts) {
+    Radiocrafts transceiver(COUNTRY_SG, false, "", true, &port);
+    ok = transceiver.begin() && transceiver.sendMessage(payload);
+  } else {
+    Wisol transceiver(COUNTRY_SG, false, "", true, &port);
+    String response;
+    ok = transceiver.begin() && (downlink
+      ? transceiver.sendMessageAndGetResponse(payload, response)
+      : transceiver.sendMessage(payload));
+    if (ok && downlink) printf("downlink=%s\n", response.c_str());
+  }
+  if (!port) { perror(argv[optind]); return 1; }
+  puts(ok ? "sent" : "FAILED");
+  return ok ? 0 : 1;
+}
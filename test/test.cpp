@@ -1,17 +1,62 @@
-//  Test the transceiver functions under Windows or Mac without Arduino.
-#ifndef ARDUINO
+//  Test the transceiver functions under Linux, Windows or Mac without Arduino.
+//  Links with the library built natively against the Arduino API in this folder.
+#ifdef UNABIZ_HOST
 #include <stdio.h>
 #include <stdlib.h>
-#include <stdint.h>
+#include <fcntl.h>
 #include <unistd.h>
-#include <time.h>
-#include "util.cpp"
-#include "../Radiocrafts.cpp"
-#include "../Akeru.cpp"
-#include "../Message.cpp"
+#include <chrono>
+#include "SIGFOX.h"
+#include "ATParser.h"
+#include "Akeru.h"
+#include "Clock.h"
+#include "ModemEmulator.h"
+#include "Capture.h"
+#include "TermiosSerial.h"
+#include "Fsm.h"
+
+//  Simulated port that runs only at the rates of a Linux serial device.  Like a
+//  device that can't be set to the rate, it stays at 9600 and reports the error.
+class TermiosRateSerial: public SoftwareSerial
+{
+public:
+  TermiosRateSerial(uint8_t receivePin, uint8_t transmitPin): SoftwareSerial(receivePin, transmitPin) {}
+  void begin(long speed) {
+    if (TermiosSerial::supportsSpeed(speed)) { SoftwareSerial::begin(speed); return; }
+    SoftwareSerial::begin(9600);
+    setWriteError();
+  }
+};
+
+//  Finite State Machine from examples/multiple_inputs.  The callbacks log a
+//  letter for each state entered and a digit for each transition.
+static String fsmLog;
+static void fsmEnterIdle() { fsmLog += 'I'; }
+static void fsmEnterBusy() { fsmLog += 'B'; }
+static void fsmEnterDone() { fsmLog += 'D'; }
+static void fsmFirstRow() { fsmLog += '1'; }
+static void fsmSecondRow() { fsmLog += '2'; }
+static constexpr State fsmIdle(0, &fsmEnterIdle, 0, 0);
+static constexpr State fsmBusy(1, &fsmEnterBusy, 0, 0);
+static constexpr State fsmDone(2, &fsmEnterDone, 0, 0);
+static const int FSM_START = 0, FSM_RESTART = 1, FSM_EVENTS = 2;
+static constexpr Transition fsmRows[] = {
+  { &fsmIdle, &fsmBusy, FSM_START, &fsmFirstRow },
+  { &fsmIdle, &fsmDone, FSM_START, &fsmSecondRow },  //  Never runs: the first matching row wins.
+  { &fsmBusy, &fsmBusy, FSM_RESTART, 0 },
+};
+static constexpr FsmTable<3, FSM_EVENTS> fsmTable = fsm_table<3, FSM_EVENTS>(fsmRows);
+static constexpr TimedTransition fsmTimedRows[] = {
+  { &fsmBusy, &fsmIdle, 500, 0 },
+  { &fsmBusy, &fsmDone, 200, 0 },  //  Shortest interval from Busy, so it fires first.
+};
+static constexpr FsmTable<3, FSM_EVENTS> fsmTimedTable = fsm_table<3, FSM_EVENTS>(fsmRows, fsmTimedRows);
 
 int main() {
   puts("test");
+  //  Run on simulated time so that delays and timeouts take no wall-clock time.
+  static VirtualClock clock;
+  setClock(&clock);
 
   static const String device = "g88pi";  //  Set this to your device name if you're using UnaBiz Emulator.
   static const bool useEmulator = false;  //  Set to true if using UnaBiz Emulator.
@@ -27,8 +72,324 @@ int main() {
   printf("encodedMsg=%s\n", encodedMsg.c_str());
   String decodedMsg = Message::decodeMessage(encodedMsg);
   printf("decodedMsg=%s\n", decodedMsg.c_str());
+  if (decodedMsg != "{\"ctr\":123.0,\"tmp\":30.1,\"hmd\":98.7}") {
+    puts("FAILED: decodedMsg does not match fields added");
+    return 1;
+  }
   msg.send();
 
+  //  Simulate a day of sending every 10 minutes, as the examples do.
+  static Radiocrafts dayTransceiver(country, useEmulator, device, false);
+  Message dayMsg(dayTransceiver);
+  dayMsg.addField("ctr", 123);
+  const unsigned long day = 24UL * 60 * 60 * 1000;
+  const unsigned long start = millis();
+  int sent = 0, failed = 0;
+  auto wallStart = std::chrono::steady_clock::now();
+  while (millis() - start < day) {
+    if (dayMsg.send()) sent++; else failed++;
+    delay(SEND_DELAY);
+  }
+  double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wallStart).count();
+  printf("simulated day: sent=%d, failed=%d, %.1f ms wall-clock, %llu clock polls\n",
+         sent, failed, wallMs, (unsigned long long) clock.getPolls());
+  if (failed > 0 || sent < (int) (day / SEND_DELAY) - 1) {
+    puts("FAILED: simulated day did not send every 10 minutes");
+    return 1;
+  }
+
+  //  Zone profiles for the countries.
+  if (getZoneProfile(COUNTRY_FR)->zone != 1 || getZoneProfile(COUNTRY_US)->zone != 2 || getZoneProfile(COUNTRY_JP)->zone != 3
+      || getZoneProfile(COUNTRY_SG)->zone != 4 || !getZoneProfile(COUNTRY_SG)->channelReset
+      || getZoneProfile(COUNTRY_FR)->channelReset || getZoneProfile(5) != 0) {
+    puts("FAILED: zone profiles");
+    return 1;
+  }
+
+  //  Parse TD1208 responses byte by byte, as Akeru does.
+  ATParser parser;
+  const char *idResponse = "\r\n1AE65E\r\nTDID: 130257003339\r\n\r\nOK\r\n";
+  uint8_t line = AT_LINE_NONE;
+  for (const char *p = idResponse; *p && line != AT_LINE_OK; p++) line = parser.feed((uint8_t) *p);
+  const bool idOk = line == AT_LINE_OK && String(parser.getData()) == "1AE65E";
+  parser.reset();
+  const char *downlinkResponse = "\r\nOK\r\n+RX BEGIN\r\n+RX=01 23 45 67 89 AB CD EF\r\n+RX END\r\n";
+  for (const char *p = downlinkResponse; *p && line != AT_LINE_DOWNLINK_END; p++) line = parser.feed((uint8_t) *p);
+  if (!idOk || line != AT_LINE_DOWNLINK_END || parser.getDownlinkLength() != 8
+      || parser.getDownlink()[0] != 0x01 || parser.getDownlink()[7] != 0xef) {
+    puts("FAILED: AT response parser");
+    return 1;
+  }
+
+  //  Send with downlink through the Wisol driver to the simulated Wisol module.
+  static WisolEmulator wisolModem;
+  SoftwareSerial::connect(6, 7, &wisolModem);
+  static Wisol wisol(country, useEmulator, device, false, 6, 7);
+  static CaptureWriter capture;
+  static CapturePort capturePort = { &capture, 0 };
+  if (!capture.open("wisol.cap")) { puts("FAILED: cannot create wisol.cap"); return 1; }
+  wisol.setCaptureHook(CaptureWriter::hook, &capturePort);
+  String response;
+  if (!wisol.begin() || !wisol.sendMessageAndGetResponse("0102030405060708090a0b0c", response)
+      || response != wisolModem.config.downlink || wisolModem.lastUplink != "0102030405060708090a0b0c") {
+    printf("FAILED: Wisol emulator downlink response=%s\n", response.c_str());
+    return 1;
+  }
+  printf("Wisol emulator: commands=%lu, downlink=%s\n", wisolModem.commands, response.c_str());
+  const SendTiming &timing = wisol.getSendTiming();
+  printf("Wisol send timing: settle=%u presend=%lu reset=%u transmit=%u response=%lu downlink=%lu total=%lu ms, "
+         "bytes sent=%u received=%u\n", timing.settle, (unsigned long) timing.presend, timing.reset, timing.transmit,
+         (unsigned long) timing.response, (unsigned long) timing.downlink, (unsigned long) timing.total,
+         timing.bytesSent, timing.bytesReceived);
+  if (timing.response < wisolModem.config.uplinkTime / 1000 || timing.downlink < wisolModem.config.downlinkTime / 1000
+      || timing.bytesSent != 7 + 33 || timing.total < timing.settle + timing.response + timing.downlink) {
+    puts("FAILED: Wisol send timing");
+    return 1;
+  }
+  //  The AT$SF response latency should be in the bucket for the uplink time.
+  LatencyHistogram &latency = wisol.getLatency();
+  latency.dump(Serial);
+  const String packed = latency.pack(COMMAND_SEND);
+  if (latency.getCount(COMMAND_SEND) != 1 || latency.timeouts[COMMAND_SEND] != 0 || packed.length() != 24
+      || latency.buckets[COMMAND_SEND][13] != 1) {  //  4096 to 8191 ms.
+    printf("FAILED: Wisol latency histogram %s\n", packed.c_str());
+    return 1;
+  }
+  capture.close();
+
+  //  Replay the captured session to another Wisol driver.  It should send the same bytes and get the same downlink.
+  std::vector<CaptureRecord> records;
+  if (!loadCapture("wisol.cap", records) || records.size() != capture.records) {
+    puts("FAILED: wisol.cap could not be loaded");
+    return 1;
+  }
+  static ReplaySerial replay(records, 0);
+  static Wisol replayWisol(country, useEmulator, device, false, &replay);
+  String replayResponse;
+  if (!replayWisol.begin() || !replayWisol.sendMessageAndGetResponse("0102030405060708090a0b0c", replayResponse)
+      || replayResponse != response || replay.mismatches != 0 || !replay.finished()) {
+    printf("FAILED: replay of wisol.cap response=%s mismatches=%lu\n", replayResponse.c_str(), replay.mismatches);
+    return 1;
+  }
+  printf("Wisol replay: %u records, downlink=%s\n", (unsigned) records.size(), replayResponse.c_str());
+
+  //  Send 5 more messages.  X,Y was 1,6 after the first send, so the driver should
+  //  skip AT$GI? for all of them and send AT$RC only once Y drops below 3.
+  wisol.setCaptureHook(0, 0);
+  const unsigned long commands = wisolModem.commands;
+  for (int i = 0; i < 5; i++) {
+    delay(SEND_DELAY);
+    if (!wisol.sendMessage("0102030405060708090a0b0c")) { puts("FAILED: Wisol send"); return 1; }
+  }
+  printf("Wisol channel tracking: skipped=%lu commands=%lu\n", wisol.getSkippedCommands(), wisolModem.commands - commands);
+  if (wisol.getSkippedCommands() != 5 || wisolModem.commands - commands != 5 + 1) {
+    puts("FAILED: Wisol channel tracking");
+    return 1;
+  }
+
+  //  Without a TTL, getTemperature() sends only AT$T?.
+  float moduleTemp, moduleVoltage; String moduleId;
+  const unsigned long uncachedCommands = wisolModem.commands;
+  if (!wisol.getTemperature(moduleTemp) || wisolModem.commands - uncachedCommands != 1) {
+    puts("FAILED: Wisol telemetry cached by default");
+    return 1;
+  }
+  //  Read the telemetry in one session.  getTemperature() and getVoltage() should use the cached values.
+  wisol.setTelemetryTTL(WISOL_TELEMETRY_TTL);
+  const unsigned long telemetryCommands = wisolModem.commands, telemetryStart = millis();
+  const bool telemetryOk = wisol.getTelemetry(moduleTemp, moduleVoltage, moduleId);
+  const unsigned long telemetryTime = millis() - telemetryStart;
+  printf("Wisol telemetry: temperature=%.1f voltage=%.2f id=%s in %lu ms\n",
+         moduleTemp, moduleVoltage, moduleId.c_str(), telemetryTime);
+  if (!telemetryOk || !wisol.getTemperature(moduleTemp) || !wisol.getVoltage(moduleVoltage)
+      || moduleTemp < 32.1 || moduleTemp > 32.3 || moduleVoltage < 3.29 || moduleVoltage > 3.31
+      || moduleId != wisolModem.config.id || wisolModem.commands - telemetryCommands != 3 || telemetryTime >= 3 * 200) {  //  Less than 3 settle delays.
+    puts("FAILED: Wisol telemetry");
+    return 1;
+  }
+
+  //  Akeru runs its commands on the same AT engine.  The simulated Wisol answers AT with OK too.
+  static WisolEmulator akeruModem;
+  SoftwareSerial::connect(12, 13, &akeruModem);
+  static Akeru akeru(12, 13);
+  if (!akeru.begin() || akeruModem.commands != 1 || akeru.getLatency().getCount(COMMAND_OTHER) != 1) {
+    puts("FAILED: Akeru AT command");
+    return 1;
+  }
+
+  //  begin() finds a module that was set to another UART rate.
+  ModemConfig fastConfig;
+  fastConfig.bitsPerSecond = 19200;
+  static WisolEmulator fastModem(fastConfig);
+  SoftwareSerial::connect(14, 15, &fastModem);
+  static Wisol fastWisol(country, useEmulator, device, false, 14, 15);
+  if (!fastWisol.begin() || fastWisol.getBitsPerSecond() != 19200 || fastModem.garbled == 0) {
+    printf("FAILED: Wisol UART rate detection: %lu bps\n", fastWisol.getBitsPerSecond());
+    return 1;
+  }
+
+  //  Compare the energy used by the Wisol above, which stays idle between sends,
+  //  with a Wisol that sleeps after each send.
+  static WisolEmulator sleepyModem;
+  SoftwareSerial::connect(8, 9, &sleepyModem);
+  static Wisol sleepyWisol(country, useEmulator, device, false, 8, 9);
+  sleepyWisol.setAutoSleep(true);
+  const unsigned long beginStart = millis();
+  if (!sleepyWisol.begin()) { puts("FAILED: Wisol with sleep did not begin"); return 1; }
+  //  ATS410, AT$I=10 and AT$I=11 are pipelined in one session: one 200 ms settle, not three.
+  const unsigned long beginTime = millis() - beginStart;
+  printf("Wisol begin: %lu ms\n", beginTime);
+  if (beginTime >= 2000 + 3 * 200) { puts("FAILED: Wisol begin commands not pipelined"); return 1; }
+  wisol.resetEnergy();
+  for (int i = 0; i < 6; i++) {
+    sleepyWisol.wakeUp();  //  Wake the module while the sensors are read.
+    if (!wisol.sendMessage("0102030405060708090a0b0c") || !sleepyWisol.sendMessage("0102030405060708090a0b0c")
+        || sleepyWisol.getSendTiming().wake != 0) {
+      puts("FAILED: Wisol send with sleep");
+      return 1;
+    }
+    delay(SEND_DELAY);
+  }
+  const EnergyUse idleUse = wisol.getEnergyUse(), sleepyUse = sleepyWisol.getEnergyUse();
+  printf("Wisol energy: idle %.3f mA, sleep %.3f mA average, %lu wakeups, battery life %.0f -> %.0f days on 2500 mAh\n",
+         idleUse.averageCurrent, sleepyUse.averageCurrent, sleepyModem.wakeups,
+         2500 / idleUse.averageCurrent / 24, 2500 / sleepyUse.averageCurrent / 24);
+  if (sleepyModem.wakeups != 5 || sleepyUse.sleep < 5 * (SEND_DELAY - 1000)
+      || sleepyUse.averageCurrent > idleUse.averageCurrent - 0.4) {
+    puts("FAILED: Wisol sleep");
+    return 1;
+  }
+
+  //  Radiocrafts commands sent back to back should stay in Command Mode, and the
+  //  driver should resync if the module is not in the mode it expects.
+  static RadiocraftsEmulator radiocraftsModem;
+  radiocraftsModem.config.bitsPerSecond = RADIOCRAFTS_BITS_PER_SECOND;
+  SoftwareSerial::connect(10, 11, &radiocraftsModem);
+  static Radiocrafts radiocrafts(country, useEmulator, device, false, 10, 11);
+  if (!radiocrafts.begin()) { puts("FAILED: Radiocrafts did not begin"); return 1; }
+  int radiocraftsTemp; float radiocraftsVoltage;
+  const unsigned long radiocraftsCommands = radiocraftsModem.commands;
+  if (!radiocrafts.getTemperature(radiocraftsTemp) || !radiocrafts.getVoltage(radiocraftsVoltage)
+      || radiocraftsModem.commands - radiocraftsCommands != 2 || radiocrafts.getMode() != COMMAND_MODE) {
+    puts("FAILED: Radiocrafts commands did not share Command Mode");
+    return 1;
+  }
+  radiocraftsModem.mode = RadiocraftsEmulator::SEND;  //  e.g. the module was reset.
+  if (!radiocrafts.getTemperature(radiocraftsTemp) || radiocrafts.getModeResyncs() != 1
+      || !radiocrafts.sendMessage("0102030405060708090a0b0c") || radiocraftsModem.lastUplink != "0102030405060708090a0b0c") {
+    puts("FAILED: Radiocrafts mode resync");
+    return 1;
+  }
+  //  Binary payloads go straight to the module, and command responses come back as bytes.
+  static const uint8_t payload[] = { 0x00, 0x01, 0xfe, 0xff };
+  delay(SEND_DELAY);
+  if (!radiocrafts.sendBytes(payload, sizeof(payload)) || radiocraftsModem.lastUplink != "0001feff"
+      || !radiocrafts.getTemperature(radiocraftsTemp) || radiocrafts.getResponseLength() != 1
+      || radiocrafts.getResponse()[0] != (uint8_t) (radiocraftsTemp + 128)) {
+    printf("FAILED: Radiocrafts binary send uplink=%s\n", radiocraftsModem.lastUplink.c_str());
+    return 1;
+  }
+  //  An empty payload would send the length byte 0x00, which is the Enter Command Mode byte.
+  delay(SEND_DELAY);
+  radiocraftsModem.lastUplink = "";
+  if (radiocrafts.sendBytes(payload, 0) || radiocrafts.sendMessage("")
+      || !radiocrafts.sendBytes(payload + 1, 3) || radiocraftsModem.lastUplink != "01feff") {
+    puts("FAILED: Radiocrafts empty payload");
+    return 1;
+  }
+  printf("Radiocrafts: temperature=%d voltage=%.2f uplink=%s\n", radiocraftsTemp, radiocraftsVoltage,
+         radiocraftsModem.lastUplink.c_str());
+
+  //  Switch the module to a faster UART.  The module keeps the rate, and another
+  //  driver finds it at begin().
+  if (!radiocrafts.setBitsPerSecond(57600) || radiocraftsModem.config.bitsPerSecond != 57600
+      || radiocraftsModem.memory[0x30] != 8 || !radiocrafts.getTemperature(radiocraftsTemp)
+      || radiocrafts.setBitsPerSecond(12345)) {
+    puts("FAILED: Radiocrafts UART rate switch");
+    return 1;
+  }
+  //  A config write that the module did not take is caught by the read back.
+  String radiocraftsResult;
+  radiocraftsModem.memory[0x28] = 1;
+  radiocraftsModem.dropConfigWrites = true;
+  if (radiocrafts.disableEmulator(radiocraftsResult) || radiocrafts.getMode() != UNKNOWN_MODE) {
+    puts("FAILED: Radiocrafts config write not verified");
+    return 1;
+  }
+  radiocraftsModem.dropConfigWrites = false;
+  if (!radiocrafts.disableEmulator(radiocraftsResult) || radiocraftsModem.memory[0x28] != 0) {
+    puts("FAILED: Radiocrafts config write after resync");
+    return 1;
+  }
+  static Radiocrafts radiocrafts2(country, useEmulator, device, false, 10, 11);
+  if (!radiocrafts2.begin() || radiocrafts2.getBitsPerSecond() != 57600) {
+    printf("FAILED: Radiocrafts UART rate detection: %lu bps\n", radiocrafts2.getBitsPerSecond());
+    return 1;
+  }
+
+  //  A serial device that can't be set to a rate must fail to open, or a module at
+  //  9600 answers the probe at 76800 and is recorded at the wrong rate.
+  int pty = posix_openpt(O_RDWR | O_NOCTTY);
+  if (pty >= 0 && grantpt(pty) == 0 && unlockpt(pty) == 0) {
+    TermiosSerial termios(ptsname(pty));
+    termios.begin(76800);
+    const bool unsupportedFailed = termios.getWriteError() && !termios;
+    termios.clearWriteError();
+    termios.begin(9600);
+    if (!unsupportedFailed || termios.getWriteError() || !termios) {
+      puts("FAILED: TermiosSerial opened at an unsupported rate");
+      return 1;
+    }
+  }
+  if (pty >= 0) close(pty);
+  static RadiocraftsEmulator slowModem;
+  slowModem.config.bitsPerSecond = 9600;
+  slowModem.memory[0x30] = 3;  //  UART_BAUD: 9600 bps
+  SoftwareSerial::connect(16, 17, &slowModem);
+  static TermiosRateSerial slowPort(16, 17);
+  static Radiocrafts slowRadiocrafts(country, useEmulator, device, false, &slowPort);
+  if (!slowRadiocrafts.begin() || slowRadiocrafts.getBitsPerSecond() != 9600) {
+    printf("FAILED: Radiocrafts UART rate detection over termios rates: %lu bps\n", slowRadiocrafts.getBitsPerSecond());
+    return 1;
+  }
+
+  //  The Fsm dispatches on the table: the first matching row wins and events out of range are ignored.
+  static Fsm fsm(&fsmIdle, fsmTable);
+  fsm.run_machine();
+  fsm.trigger(-1);
+  fsm.trigger(FSM_EVENTS);
+  fsm.trigger(FSM_RESTART);  //  No row for Idle.
+  fsm.trigger(FSM_START);
+  fsm.trigger(FSM_RESTART);
+  if (fsmLog != "I1BB") {
+    printf("FAILED: Fsm dispatch log=%s\n", fsmLog.c_str());
+    return 1;
+  }
+  //  Timed transitions: the shortest interval fires first, and a self-transition restarts the deadline.
+  //  Each millis() call moves the virtual clock on by 1 ms, so the deadlines may be a few ms short.
+  static Fsm timedFsm(&fsmIdle, fsmTimedTable);
+  fsmLog = "";
+  timedFsm.run_machine();
+  const unsigned long idleDeadline = timedFsm.nextDeadline();
+  timedFsm.trigger(FSM_START);
+  const unsigned long busyDeadline = timedFsm.nextDeadline();
+  delay(150);
+  const unsigned long laterDeadline = timedFsm.nextDeadline();
+  timedFsm.trigger(FSM_RESTART);
+  const unsigned long restartDeadline = timedFsm.nextDeadline();
+  delay(150);
+  timedFsm.run_machine();
+  const String beforeDeadline = fsmLog;
+  delay(50);
+  timedFsm.run_machine();
+  if (idleDeadline != FSM_NO_DEADLINE || busyDeadline > 200 || busyDeadline < 195 || laterDeadline > 50
+      || laterDeadline < 45 || restartDeadline > 200 || restartDeadline < 195
+      || beforeDeadline != "I1BB" || fsmLog != "I1BBD" || timedFsm.nextDeadline() != FSM_NO_DEADLINE) {
+    printf("FAILED: Fsm timed transitions log=%s deadlines=%lu,%lu,%lu,%lu\n", fsmLog.c_str(),
+           idleDeadline, busyDeadline, laterDeadline, restartDeadline);
+    return 1;
+  }
+
 #if NOTUSED
   setup();
   for (;;) {
@@ -38,4 +399,4 @@ int main() {
 #endif
   return 0;
 }
-#endif  //  ARDUINO
+#endif  //  UNABIZ_HOST